@@ -283,6 +283,19 @@ void shift_aliaslist_index(aliaslist_T *list, size_t i, ptrdiff_t inc)
     }
 }
 
+/* Returns true iff the limit index of every item in the list is less than `i',
+ * that is, the text at index `i' is not a result of substitution and no item
+ * in the list affects substitution at or after `i'. */
+bool is_aliaslist_expired(const aliaslist_T *list, size_t i)
+{
+    while (list != NULL) {
+        if (list->limitindex >= i)
+            return false;
+        list = list->next;
+    }
+    return true;
+}
+
 /* Performs alias substitution on the word starting at index `i' in buffer
  * `buf'. */
 bool substitute_alias(xwcsbuf_T *restrict buf, size_t i,
@@ -368,7 +381,10 @@ bool is_redir_fd(const wchar_t *s)
  * Returns true iff successful. */
 bool print_alias(const wchar_t *name, const alias_T *alias, bool prefix)
 {
-    wchar_t *qvalue = quote_as_word(alias->value);
+    wchar_t array[XWCSBUF_STACKSIZE];
+    xwcsbuf_T qvalue;
+    wb_initwithstack(&qvalue, array, XWCSBUF_STACKSIZE);
+    wb_quote_as_word(&qvalue, alias->value);
     const char *format;
     bool success;
 
@@ -385,8 +401,8 @@ bool print_alias(const wchar_t *name, const alias_T *alias, bool prefix)
         else
             format = "alias %ls=%ls\n";
 
-    success = xprintf(format, name, qvalue);
-    free(qvalue);
+    success = xprintf(format, name, qvalue.contents);
+    wb_destroy(&qvalue);
     return success;
 }
 
@@ -474,7 +490,7 @@ int alias_builtin(int argc, void **argv)
     if (xoptind == argc) {
         /* print all aliases */
         kvpair_T *kvs = ht_tokvarray(&aliases);
-        qsort(kvs, aliases.count, sizeof *kvs, keywcscoll);
+        collsort(kvs, aliases.count, sizeof *kvs, kvwcskeyof);
         for (size_t i = 0; i < aliases.count; i++) {
             print_alias(kvs[i].key, kvs[i].value, prefix);
             if (yash_error_message_count > 0)
@@ -37,6 +37,8 @@ extern const wchar_t *get_alias_value(const wchar_t *aliasname)
 extern void destroy_aliaslist(struct aliaslist_T *list);
 extern void shift_aliaslist_index(
         struct aliaslist_T *list, size_t i, ptrdiff_t inc);
+extern _Bool is_aliaslist_expired(const struct aliaslist_T *list, size_t i)
+    __attribute__((pure));
 extern _Bool substitute_alias(
         struct xwcsbuf_T *restrict buf, size_t i,
         struct aliaslist_T **restrict list, substaliasflags_T flags)
@@ -81,6 +81,10 @@ typedef struct pipeinfo_T {
 } pipeinfo_T;
 #define PIPEINFO_INIT { -1, { -1, -1 }, }
 
+/* size of the automatic array used as the initial storage of the buffer that
+ * reads the output of a command substitution */
+#define CMDSUB_STACK_SIZE 128
+
 /* values used to specify the behavior of command search. */
 typedef enum srchcmdtype_T {
     SCT_EXTERNAL = 1 << 0,  /* search for an external command */
@@ -852,15 +856,18 @@ void print_xtrace(void *const *argv)
             first = false;
         }
         if (argv != NULL) {
+            wchar_t array[XWCSBUF_STACKSIZE];
+            xwcsbuf_T quoted;
+            wb_initwithstack(&quoted, array, XWCSBUF_STACKSIZE);
             for (void *const *a = argv; *a != NULL; a++) {
                 if (!first)
                     fputc(' ', stderr);
                 first = false;
 
-                wchar_t *quoted = quote_as_word(*a);
-                fprintf(stderr, "%ls", quoted);
-                free(quoted);
+                wb_quote_as_word(wb_clear(&quoted), *a);
+                fprintf(stderr, "%ls", quoted.contents);
             }
+            wb_destroy(&quoted);
         }
         fputc('\n', stderr);
 
@@ -1091,6 +1098,15 @@ void exec_external_program(
 
     xexecve(path, mbsargv, envs);
     int saveerrno = errno;
+    if (saveerrno == ENOENT || saveerrno == EACCES) {
+        /* The remembered path may be out of date. */
+        const char *newpath = refresh_command_path(path);
+        if (newpath != NULL) {
+            path = newpath;
+            xexecve(path, mbsargv, envs);
+            saveerrno = errno;
+        }
+    }
     if (saveerrno != ENOEXEC) {
         if (saveerrno == EACCES && is_directory(path))
             saveerrno = EISDIR;
@@ -1603,9 +1619,10 @@ wchar_t *exec_command_substitution(const embedcmd_T *cmdsub)
         }
 
         /* read output from the command */
+        wchar_t array[CMDSUB_STACK_SIZE];
         xwcsbuf_T buf;
         wint_t c;
-        wb_init(&buf);
+        wb_initwithstack(&buf, array, CMDSUB_STACK_SIZE);
         while ((c = fgetwc(f)) != WEOF)
             wb_wccat(&buf, c);
         fclose(f);
@@ -1739,8 +1756,7 @@ bool autoload_completion_function_file(
     if (mbsfilename == NULL)
         return false;
 
-    char *path = which(mbsfilename, get_path_array(PA_LOADPATH),
-            is_readable_regular);
+    char *path = which_loadpath(mbsfilename);
     if (path == NULL) {
         le_compdebug("file \"%s\" was not found in $YASH_LOADPATH",
                 mbsfilename);
@@ -2092,8 +2108,13 @@ int dot_builtin(int argc, void **argv)
 
     char *path;
     if (autoload) {
-        path = which(mbsfilename, get_path_array(PA_LOADPATH),
-                is_readable_regular);
+#if YASH_ENABLE_LINEEDIT
+        if (le_state & LE_STATE_COMPLETING)
+            path = which_loadpath(mbsfilename);
+        else
+#endif
+            path = which(mbsfilename, get_path_array(PA_LOADPATH),
+                    is_readable_regular);
         if (path == NULL) {
             xerror(0, Ngt("file `%s' was not found in $YASH_LOADPATH"),
                     mbsfilename);
@@ -145,6 +145,9 @@ static inline bool should_escape(charcategory_T cc, escaping_T escaping)
 static wchar_t *quote_removal_free(
         wchar_t *restrict s, char *restrict cc, escaping_T escaping)
     __attribute__((nonnull,malloc,warn_unused_result));
+static xwcsbuf_T *wb_quote_removal(xwcsbuf_T *restrict buf,
+        const wchar_t *restrict s, const char *restrict cc, escaping_T escaping)
+    __attribute__((nonnull));
 
 static enum wglobflags_T get_wglobflags(void)
     __attribute__((pure));
@@ -399,13 +402,16 @@ struct expand_four_T expand_four(const wordunit_T *restrict w,
     pl_init(&e.valuelist);
     pl_init(&e.cclist);
 
-    /* intermediate value of the currently expanded word */
+    /* intermediate value of the currently expanded word. Most words are
+     * short enough to be built in the automatic arrays without allocation. */
+    wchar_t valuearray[XWCSBUF_STACKSIZE];
     xwcsbuf_T valuebuf;
-    wb_init(&valuebuf);
+    wb_initwithstack(&valuebuf, valuearray, XWCSBUF_STACKSIZE);
 
     /* charcategory_T string corresponding to `valuebuf' */
+    char ccarray[XSTRBUF_STACKSIZE];
     xstrbuf_T ccbuf;
-    sb_init(&ccbuf);
+    sb_initwithstack(&ccbuf, ccarray, XSTRBUF_STACKSIZE);
 
     bool indq = false;  /* in a double quote? */
     bool first = true;  /* is the first word unit? */
@@ -1709,12 +1715,21 @@ wchar_t *escape(const wchar_t *restrict s, const wchar_t *restrict t)
 {
     xwcsbuf_T buf;
     wb_initwithmax(&buf, mul(wcslen(s), 2));
+    wb_escape(&buf, s, t);
+    return wb_towcs(&buf);
+}
+
+/* Like `escape', but the result is appended to the given buffer, which must
+ * have been initialized before calling this function. */
+xwcsbuf_T *wb_escape(xwcsbuf_T *restrict buf,
+        const wchar_t *restrict s, const wchar_t *restrict t)
+{
     for (size_t i = 0; s[i] != L'\0'; i++) {
         if (t == NULL || wcschr(t, s[i]) != NULL)
-            wb_wccat(&buf, L'\\');
-        wb_wccat(&buf, s[i]);
+            wb_wccat(buf, L'\\');
+        wb_wccat(buf, s[i]);
     }
-    return wb_towcs(&buf);
+    return buf;
 }
 
 /* Same as `escape', except that the first argument is freed. */
@@ -1882,14 +1897,23 @@ wchar_t *quote_removal(
 {
     xwcsbuf_T result;
     wb_initwithmax(&result, mul(wcslen(s), 2));
+    wb_quote_removal(&result, s, cc, escaping);
+    return wb_towcs(&result);
+}
+
+/* Like `quote_removal', but the result is appended to the given buffer, which
+ * must have been initialized before calling this function. */
+xwcsbuf_T *wb_quote_removal(xwcsbuf_T *restrict buf,
+        const wchar_t *restrict s, const char *restrict cc, escaping_T escaping)
+{
     for (size_t i = 0; s[i] != L'\0'; i++) {
         if (cc[i] & CC_QUOTATION)
             continue;
         if (should_escape(cc[i], escaping))
-            wb_wccat(&result, L'\\');
-        wb_wccat(&result, s[i]);
+            wb_wccat(buf, L'\\');
+        wb_wccat(buf, s[i]);
     }
-    return wb_towcs(&result);
+    return buf;
 }
 
 /* Like `quote_removal', but frees the arguments. */
@@ -1913,6 +1937,7 @@ enum wglobflags_T get_wglobflags(void)
     if (shopt_dotglob)      flags |= WGLB_PERIOD;
     if (shopt_markdirs)     flags |= WGLB_MARK;
     if (shopt_extendedglob) flags |= WGLB_RECDIR;
+    if (shopt_parallelglob) flags |= WGLB_PARALLEL;
     return flags;
 }
 
@@ -1926,10 +1951,17 @@ void glob_all(struct expand_four_T *restrict e, plist_T *restrict results)
     enum wglobflags_T flags = get_wglobflags();
     bool unblock = false;
 
+    /* buffer for the pattern, which is reused for all the fields */
+    wchar_t patternarray[XWCSBUF_STACKSIZE];
+    xwcsbuf_T patternbuf;
+    wb_initwithstack(&patternbuf, patternarray, XWCSBUF_STACKSIZE);
+
     for (size_t i = 0; i < e->valuelist.length; i++) {
         wchar_t *field = e->valuelist.contents[i];
         char *cc = e->cclist.contents[i];
-        wchar_t *pattern = quote_removal(field, cc, ES_QUOTED_HARD);
+        wb_ensuremax(wb_clear(&patternbuf), mul(wcslen(field), 2));
+        const wchar_t *pattern = wb_quote_removal(
+                &patternbuf, field, cc, ES_QUOTED_HARD)->contents;
         if (shopt_glob && is_pathname_matching_pattern(pattern)) {
             if (!unblock) {
                 set_interruptible_by_sigint(true);
@@ -1948,8 +1980,8 @@ quote_removal:
         }
         free(field);
         free(cc);
-        free(pattern);
     }
+    wb_destroy(&patternbuf);
     if (unblock)
         set_interruptible_by_sigint(false);
     pl_destroy(&e->valuelist);
@@ -110,6 +110,9 @@ extern wchar_t *extract_fields(
 struct xwcsbuf_T;
 extern wchar_t *escape(const wchar_t *restrict s, const wchar_t *restrict t)
     __attribute__((nonnull(1),malloc,warn_unused_result));
+extern struct xwcsbuf_T *wb_escape(struct xwcsbuf_T *restrict buf,
+        const wchar_t *restrict s, const wchar_t *restrict t)
+    __attribute__((nonnull(1,2)));
 extern wchar_t *escapefree(
         wchar_t *restrict s, const wchar_t *restrict t)
     __attribute__((nonnull(1),malloc,warn_unused_result));
@@ -408,6 +408,13 @@ int keywcscoll(const void *k1, const void *k2)
     return wcscoll(((const kvpair_T *) k1)->key, ((const kvpair_T *) k2)->key);
 }
 
+/* Returns the wide-string key of the key-value pair (const kvpair_T *) `kv'.
+ * Can be used as the `keyof' function to `collsort'. */
+const wchar_t *kvwcskeyof(const void *kv)
+{
+    return ((const kvpair_T *) kv)->key;
+}
+
 /* `Free's the key of the specified key-value pair.
  * Can be used as the freer function to `ht_clear'. */
 void kfree(kvpair_T kv)
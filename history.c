@@ -31,6 +31,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
@@ -38,6 +39,7 @@
 #include <wctype.h>
 #include "builtin.h"
 #include "exec.h"
+#include "hashtable.h"
 #include "job.h"
 #include "option.h"
 #include "path.h"
@@ -47,6 +49,9 @@
 #include "util.h"
 #include "variable.h"
 #include "yash.h"
+#if YASH_ENABLE_LINEEDIT
+# include "lineedit/editing.h"
+#endif
 
 
 /* The maximum size of history list (<= INT_MAX / 10) */
@@ -101,6 +106,14 @@ static unsigned histsize = DEFAULT_HISTSIZE;
 /* When a new entry is added, if there are entries that has the same value as
  * the new entry in the `histrmdup' newest entries, those entries are removed.*/
 static unsigned histrmdup = 0;
+/* If `histrmdup' is positive, this hashtable maps each distinct value in the
+ * history to the newest entry that has the value. Older entries with the same
+ * value are reached through the `dupolder' member of the entry, so duplicates
+ * of a new entry are found without comparing it with other entries. The keys
+ * are the `value' members of the entries. */
+static hashtable_T histvalues;
+/* The serial number assigned to the next new entry. */
+static unsigned long histserial = 1;
 
 /* File stream for the history file. */
 static FILE *histfile = NULL;
@@ -112,6 +125,17 @@ static long histfilerev = -1;
 static size_t histfilelines = 0;
 /* Indicates if the history file should be flushed before it is unlocked. */
 static bool histneedflush = false;
+/* True iff the history file is in the binary format. */
+static bool histfilebinary = false;
+/* In the binary format, the offset in the history file up to which records
+ * have been read or written. */
+static off_t histfilepos = 0;
+/* True iff the binary history file has data after `histfilepos' that should be
+ * truncated when the file is next flushed. */
+static bool histfilegarbage = false;
+/* Records that are to be written to the binary history file at `histfilepos'
+ * when the file is flushed. */
+static xstrbuf_T histfilebuf;
 
 /* The current time returned by `time' */
 static time_t now = (time_t) -1;
@@ -132,6 +156,20 @@ static bool need_remove_entry(unsigned number)
     __attribute__((pure));
 static void remove_entry(histentry_T *e)
     __attribute__((nonnull));
+static void unlink_duplicate(histentry_T *entry)
+    __attribute__((nonnull));
+static unsigned hash_ngram(const char *s, size_t n)
+    __attribute__((nonnull,pure));
+static struct histblock_T *get_histblock(unsigned long serial)
+    __attribute__((pure));
+static void index_add_entry(histentry_T *entry)
+    __attribute__((nonnull));
+static void index_remove_entry(histentry_T *entry)
+    __attribute__((nonnull));
+static void index_clear(void);
+static void index_build(void);
+static bool entry_is_recent(const histentry_T *entry, unsigned n)
+    __attribute__((nonnull,pure));
 static void remove_last_entry(void);
 static void clear_all_entries(void);
 static struct search_result_T search_entry_by_number(unsigned number)
@@ -159,17 +197,23 @@ static bool try_read_line(FILE *restrict f, xwcsbuf_T *restrict buf)
     __attribute__((nonnull));
 static long read_signature(void);
 static void read_history_raw(void);
-static void read_history(void);
+static bool read_history(void);
+static bool read_history_binary(void);
 static void parse_history_entry(const wchar_t *line)
     __attribute__((nonnull));
 static void parse_removed_entry(const wchar_t *numstr)
     __attribute__((nonnull));
+static void remove_entry_numbered(unsigned long num);
 static void parse_process_id(const wchar_t *numstr)
     __attribute__((nonnull));
 static void update_history(bool refresh);
 static void maybe_refresh_file(void);
 static int wprintf_histfile(const wchar_t *format, ...)
     __attribute__((nonnull));
+static void add_histbin_record(
+        char type, intmax_t value, time_t time, const char *payload);
+static void flush_histbin(void);
+static void write_histfile_record(char type, intmax_t value);
 static void write_signature(void);
 static void write_history_entry(const histentry_T *entry)
     __attribute__((nonnull));
@@ -221,13 +265,29 @@ histentry_T *new_entry(unsigned number, time_t time, const char *line)
     new->Prev = histlist.Newest;
     new->Next = Histlist;
     histlist.Newest = new->Prev->next = &new->link;
+    new->serial = histserial++;
     new->number = number;
     new->time = time;
     strcpy(new->value, line);
 
+    index_add_entry(new);
+
+    new->dupnewer = NULL;
+    if (histrmdup > 0) {
+        new->dupolder = ht_set(&histvalues, new->value, new).value;
+        if (new->dupolder != NULL)
+            new->dupolder->dupnewer = new;
+    } else {
+        new->dupolder = NULL;
+    }
+
     histlist.count++;
     assert(histlist.count <= histsize);
 
+#if YASH_ENABLE_LINEEDIT
+    le_predict_add_history(new);
+#endif
+
     return new;
 }
 
@@ -251,12 +311,50 @@ void remove_entry(histentry_T *entry)
 {
     assert(!hist_lock);
     assert(&entry->link != Histlist);
+    index_remove_entry(entry);
+#if YASH_ENABLE_LINEEDIT
+    le_predict_remove_history(entry);
+#endif
     entry->Prev->next = entry->Next;
     entry->Next->prev = entry->Prev;
     histlist.count--;
+    if (histrmdup > 0)
+        unlink_duplicate(entry);
     free(entry);
 }
 
+/* Removes the specified entry from `histvalues' and the chain of entries that
+ * have the same value. */
+void unlink_duplicate(histentry_T *entry)
+{
+    if (entry->dupolder != NULL)
+        entry->dupolder->dupnewer = entry->dupnewer;
+    if (entry->dupnewer != NULL)
+        entry->dupnewer->dupolder = entry->dupolder;
+    else if (entry->dupolder != NULL)
+        ht_set(&histvalues, entry->dupolder->value, entry->dupolder);
+    else
+        ht_remove(&histvalues, entry->value);
+}
+
+/* Returns true iff the specified entry is one of the `n' newest entries.
+ * Since entries may have been removed from the middle of the list, the
+ * difference of serial numbers is only an upper bound of the number of newer
+ * entries. The list is walked only if the bound is inconclusive. */
+bool entry_is_recent(const histentry_T *entry, unsigned n)
+{
+    if (histlist.count <= n)
+        return true;
+    if (ashistentry(histlist.Newest)->serial - entry->serial < n)
+        return true;
+
+    const histlink_T *l = histlist.Newest;
+    for (unsigned i = 0; i < n; i++, l = l->prev)
+        if (l == &entry->link)
+            return true;
+    return false;
+}
+
 /* Removes the newest entry. */
 void remove_last_entry(void)
 {
@@ -264,16 +362,32 @@ void remove_last_entry(void)
         remove_entry(ashistentry(histlist.Newest));
 }
 
-/* Renumbers all the entries in `histlist', starting from 1. */
+/* Renumbers all the entries in `histlist', starting from 1.
+ * The serial numbers are also renumbered to remove gaps between them. */
 void renumber_all_entries(void)
 {
     assert(!hist_lock);
 
-    if (histlist.count > 0) {
-        unsigned num = 0;
-        for (histlink_T *l = histlist.Oldest; l != Histlist; l = l->next)
-            ashistentry(l)->number = ++num;
-        assert(num == histlist.count);
+    unsigned num = 0;
+    bool reserialized = false;
+    for (histlink_T *l = histlist.Oldest; l != Histlist; l = l->next) {
+        histentry_T *e = ashistentry(l);
+        e->number = ++num;
+        if (e->serial != num) {
+            e->serial = num;
+            reserialized = true;
+        }
+    }
+    assert(num == histlist.count);
+    histserial = (unsigned long) num + 1;
+
+    /* The search index and the prediction models are organized by serial
+     * numbers. */
+    if (reserialized) {
+        index_clear();
+#if YASH_ENABLE_LINEEDIT
+        le_predict_reset_history();
+#endif
     }
 }
 
@@ -290,6 +404,12 @@ void clear_all_entries(void)
     }
     histlist.Oldest = histlist.Newest = Histlist;
     histlist.count = 0;
+    if (histrmdup > 0)
+        ht_clear(&histvalues, NULL);
+    index_clear();
+#if YASH_ENABLE_LINEEDIT
+    le_predict_reset_history();
+#endif
 }
 
 /* Searches for the entry that has the specified `number'.
@@ -406,6 +526,204 @@ bool entry_is_newer(const histentry_T *e1, const histentry_T *e2)
 }
 
 
+/********** Search index **********/
+
+/* To speed up history search in line-editing, history entries are grouped into
+ * blocks of `HISTINDEX_BLOCK' entries by their serial numbers. Each block has a
+ * bit set that has a bit set for the hash of each byte, pair of bytes, and
+ * trigram (three consecutive bytes) in the values of the entries in the block.
+ * A search for a string can skip all entries of a block whose bit set lacks any
+ * trigram of the string (or the string itself if it is shorter than a
+ * trigram). Bits are not cleared when entries are removed, so the bit sets may
+ * give false positives but never false negatives.
+ * The index is built when the first search is made and then maintained as
+ * entries are added and removed. */
+
+#define HISTINDEX_BLOCK    64
+#define HISTINDEX_HASHBITS 12
+#define HISTINDEX_BITS     (1 << HISTINDEX_HASHBITS)
+
+struct histblock_T {
+    histentry_T *first, *last;
+    unsigned char bits[HISTINDEX_BITS / CHAR_BIT];
+};
+/* `first' and `last' are the oldest and newest entries in the block. Both are
+ * NULL if the block has no entries. */
+
+/* The blocks of the index. `histblocks[i]' contains the entries whose serial
+ * numbers divided by `HISTINDEX_BLOCK' equal `histblockbase + i'. */
+static struct histblock_T **histblocks = NULL;
+static size_t histblockcount = 0, histblockcapacity = 0;
+static unsigned long histblockbase = 0;
+/* True iff the index has been built and is maintained. */
+static bool histindexed = false;
+
+/* The structure of a compiled search string. */
+struct histsearch_T {
+    size_t count;
+    unsigned hashes[];
+};
+
+/* Returns the hash value of the first `n' bytes of `s', where `n' is 1, 2, or
+ * 3 and `s' has at least `n' bytes. */
+unsigned hash_ngram(const char *s, size_t n)
+{
+    uint_least32_t v = (uint_least32_t) n;
+    for (size_t i = 0; i < n; i++)
+        v = (v << 8) | (unsigned char) s[i];
+    v = (v * UINT32_C(2654435761)) & UINT32_C(0xFFFFFFFF);
+    return (unsigned) (v >> (32 - HISTINDEX_HASHBITS));
+}
+
+/* Returns the block that contains the entry of the specified serial number. */
+struct histblock_T *get_histblock(unsigned long serial)
+{
+    unsigned long id = serial / HISTINDEX_BLOCK;
+    assert(id - histblockbase < histblockcount);
+    return histblocks[id - histblockbase];
+}
+
+/* Adds the specified entry, which must be the newest, to the index. */
+void index_add_entry(histentry_T *entry)
+{
+    if (!histindexed)
+        return;
+
+    unsigned long id = entry->serial / HISTINDEX_BLOCK;
+    if (histblockcount == 0)
+        histblockbase = id;
+    assert(id >= histblockbase);
+    while (id - histblockbase >= histblockcount) {
+        if (histblockcount == histblockcapacity) {
+            histblockcapacity = (histblockcapacity == 0)
+                ? 8 : add(histblockcapacity, histblockcapacity);
+            histblocks = xreallocn(
+                    histblocks, histblockcapacity, sizeof *histblocks);
+        }
+        struct histblock_T *b = xmalloc(sizeof *b);
+        b->first = b->last = NULL;
+        memset(b->bits, 0, sizeof b->bits);
+        histblocks[histblockcount++] = b;
+    }
+
+    struct histblock_T *b = histblocks[id - histblockbase];
+    if (b->first == NULL)
+        b->first = entry;
+    b->last = entry;
+    for (const char *s = entry->value; s[0] != '\0'; s++) {
+        for (size_t n = 1; n <= 3; n++) {
+            unsigned h = hash_ngram(s, n);
+            b->bits[h / CHAR_BIT] |= 1u << (h % CHAR_BIT);
+            if (s[n] == '\0')
+                break;
+        }
+    }
+}
+
+/* Removes the specified entry from the index. This function must be called
+ * before the entry is unlinked from `histlist'. */
+void index_remove_entry(histentry_T *entry)
+{
+    if (!histindexed)
+        return;
+
+    struct histblock_T *b = get_histblock(entry->serial);
+    if (b->first == entry) {
+        if (b->last == entry)
+            b->first = b->last = NULL;
+        else
+            b->first = ashistentry(entry->Next);
+    } else if (b->last == entry) {
+        b->last = ashistentry(entry->Prev);
+    }
+
+    /* free blocks that have become empty at the oldest end */
+    size_t n = 0;
+    while (n < histblockcount && histblocks[n]->first == NULL)
+        free(histblocks[n++]);
+    if (n > 0) {
+        histblockcount -= n;
+        histblockbase += n;
+        memmove(histblocks, &histblocks[n],
+                histblockcount * sizeof *histblocks);
+    }
+}
+
+/* Removes all blocks from the index. The index will be rebuilt when it is next
+ * used. */
+void index_clear(void)
+{
+    for (size_t i = 0; i < histblockcount; i++)
+        free(histblocks[i]);
+    histblockcount = 0;
+    histindexed = false;
+}
+
+/* Builds the index if it has not been built. */
+void index_build(void)
+{
+    if (histindexed)
+        return;
+    histindexed = true;
+    for (histlink_T *l = histlist.Oldest; l != Histlist; l = l->next)
+        index_add_entry(ashistentry(l));
+}
+
+/* Compiles the specified string for use in `histsearch_next'.
+ * Returns NULL if the index cannot be used to search for the string, that is,
+ * if the string is empty or the encoding of the locale is state-dependent, in
+ * which case a substring of an entry may not be encoded as a substring of the
+ * entry's value. */
+histsearch_T *histsearch_compile(const char *s)
+{
+    size_t length = strlen(s);
+    if (length == 0 || mblen(NULL, 0) != 0)
+        return NULL;
+
+    index_build();
+
+    size_t n = (length < 3) ? length : 3;
+    histsearch_T *search = xmallocs(sizeof *search,
+            length - n + 1, sizeof *search->hashes);
+    search->count = length - n + 1;
+    for (size_t i = 0; i < search->count; i++)
+        search->hashes[i] = hash_ngram(&s[i], n);
+    return search;
+}
+
+/* Returns the entry next to `l' in the specified direction that may contain the
+ * string compiled in `search'. `Histlist' is returned if there is no such
+ * entry. The caller must check if the returned entry really contains the
+ * string. */
+const histlink_T *histsearch_next(
+        const histsearch_T *search, const histlink_T *l, bool forward)
+{
+    for (;;) {
+        l = forward ? l->next : l->prev;
+        if (l == Histlist)
+            return l;
+
+        const struct histblock_T *b = get_histblock(ashistentry(l)->serial);
+        for (size_t i = 0; ; i++) {
+            if (i == search->count)
+                return l;
+            unsigned h = search->hashes[i];
+            if (!(b->bits[h / CHAR_BIT] & (1u << (h % CHAR_BIT))))
+                break;
+        }
+
+        /* skip the rest of the block */
+        l = forward ? &b->last->link : &b->first->link;
+    }
+}
+
+/* Frees the value returned by `histsearch_compile'. */
+void histsearch_free(histsearch_T *search)
+{
+    free(search);
+}
+
+
 /********** Process ID list **********/
 
 struct pidlist_T {
@@ -464,7 +782,7 @@ void write_histfile_pids(void)
 {
     assert(histfile != NULL);
     for (size_t i = 0; i < histfilepids.count; i++)
-        wprintf_histfile(L"p%jd\n", (intmax_t) histfilepids.pids[i]);
+        write_histfile_record('p', histfilepids.pids[i]);
     histfilelines += histfilepids.count;
 }
 
@@ -504,8 +822,49 @@ void write_histfile_pids(void)
  *    pXXX
  * where `XXX' is the process id (decimal integer). For addition `XXX' is
  * positive and for elimination `XXX' is negative.
+ *
+ ***** BINARY FORMAT OF THE HISTORY FILE *****
+ *
+ * When the hist-binary option is enabled, the history file is written in an
+ * alternative, append-only binary format that can be read without parsing
+ * text. The file starts with a `struct histbinheader_T' containing the magic
+ * bytes `HISTBIN_MAGIC' and the revision number, which is followed by any
+ * number of records. A record is a `struct histbinrecord_T' followed by a
+ * payload of `hr_length' bytes, padded with null bytes up to a multiple of
+ * eight bytes. The `hr_type' member determines the meaning of the record in
+ * the same way as the first character of a line in the text format:
+ *    'e'    history entry: `hr_value' is the entry number, `hr_time' is the
+ *           time of the command (negative if unknown), and the payload is the
+ *           null-terminated command in the multibyte encoding of the locale
+ *    'c'    history entry cancellation
+ *    'd'    history entry deletion: `hr_value' is the number of the entry
+ *    'p'    shell process addition/elimination: `hr_value' is the signed
+ *           process ID
+ * Records of other types are ignored. Integers are in the native byte order,
+ * so the file is not portable between machines of different architectures.
+ * An incomplete record at the end of the file is ignored and overwritten by
+ * the next record written.
  */
 
+#define HISTBIN_MAGIC "\0yash-h1"
+
+struct histbinheader_T {
+    char hb_magic[8];
+    int64_t hb_revision;
+};
+
+struct histbinrecord_T {
+    uint8_t hr_type;
+    uint8_t hr_reserved[3];
+    uint32_t hr_length;
+    int64_t hr_value;
+    int64_t hr_time;
+};
+
+/* Returns the size of a binary record that has a payload of `length' bytes. */
+#define HISTBIN_RECORD_SIZE(length) \
+    (sizeof (struct histbinrecord_T) + (((size_t) (length) + 7) & ~(size_t) 7))
+
 /* Opens the history file.
  * Returns NULL on failure. */
 FILE *open_histfile(void)
@@ -553,7 +912,10 @@ bool lock_histfile(short type)
 {
     if (type == F_UNLCK && histneedflush) {
         histneedflush = false;
-        fflush(histfile);
+        if (histfilebinary)
+            flush_histbin();
+        else
+            fflush(histfile);
         /* We only flush the history file after writing. POSIX doesn't define
          * the behavior of flush without writing. We don't use fseek instead of
          * fflush because fseek is less reliable than fflush. In some
@@ -639,7 +1001,8 @@ bool try_read_line(FILE *restrict f, xwcsbuf_T *restrict buf)
 /* Reads the signature of the history file (`histfile') and checks if it is a
  * valid signature.
  * If valid:
- *   - the file is positioned just after the signature,
+ *   - the file is positioned just after the signature (`histfilepos' is set
+ *     instead if the file is in the binary format),
  *   - the return value is the revision of the file (non-negative).
  * Otherwise:
  *   - the file position is undefined,
@@ -652,6 +1015,20 @@ long read_signature(void)
     const wchar_t *s;
 
     assert(histfile != NULL);
+
+    struct histbinheader_T header;
+    if (pread(fileno(histfile), &header, sizeof header, 0) == sizeof header
+            && memcmp(header.hb_magic, HISTBIN_MAGIC, sizeof header.hb_magic)
+                == 0) {
+        histfilebinary = true;
+        histfilepos = sizeof header;
+        histfilegarbage = false;
+        if (header.hb_revision < 0 || header.hb_revision > LONG_MAX)
+            return -1;
+        return (long) header.hb_revision;
+    }
+    histfilebinary = false;
+
     rewind(histfile);
     if (!read_line(histfile, wb_initwithmax(&buf, HISTORY_DEFAULT_LINE_LENGTH)))
         goto end;
@@ -692,17 +1069,20 @@ void read_history_raw(void)
 }
 
 /* Reads history entries from the history file.
- * The file is read from the current position.
+ * The file is read from the current position (or `histfilepos' if the file is
+ * in the binary format).
  * The entries that were read from the file are appended to `histlist'.
- * `update_time' must be called before calling this function. */
+ * `update_time' must be called before calling this function.
+ * Returns true iff the file was read to the end without error. */
 /* The file should be locked. */
-/* This function does not return any error status. The caller should check
- * `ferror' and/or `feof' for the file. */
-void read_history(void)
+bool read_history(void)
 {
     xwcsbuf_T buf;
 
     assert(histfile != NULL);
+    if (histfilebinary)
+        return read_history_binary();
+
     wb_initwithmax(&buf, HISTORY_DEFAULT_LINE_LENGTH);
     while (read_line(histfile, &buf)) {
         histfilelines++;
@@ -725,6 +1105,73 @@ void read_history(void)
         wb_clear(&buf);
     }
     wb_destroy(&buf);
+    return !ferror(histfile) && feof(histfile);
+}
+
+/* Reads records from the binary history file, starting from `histfilepos'.
+ * The file is mapped into memory rather than read through the stream so that
+ * records that have already been read need not be touched again.
+ * `histfilepos' is advanced to the end of the last complete record.
+ * Returns true iff successful. */
+/* The file should be locked. */
+bool read_history_binary(void)
+{
+    int fd = fileno(histfile);
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < histfilepos)
+        return false;
+    if (st.st_size == histfilepos)
+        return true;
+    if ((uintmax_t) st.st_size > SIZE_MAX)
+        return false;
+
+    size_t size = (size_t) st.st_size;
+    const char *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+        return false;
+
+    size_t pos = (size_t) histfilepos;
+    while (size - pos >= sizeof (struct histbinrecord_T)) {
+        struct histbinrecord_T r;
+        memcpy(&r, &map[pos], sizeof r);
+        if (r.hr_length > size - pos - sizeof r
+                || HISTBIN_RECORD_SIZE(r.hr_length) > size - pos)
+            break;
+
+        const char *payload = &map[pos + sizeof r];
+        histfilelines++;
+        switch (r.hr_type) {
+            case 'e':
+                if (r.hr_value <= 0 || r.hr_value > max_number)
+                    break;
+                if (r.hr_length == 0 || payload[r.hr_length - 1] != '\0')
+                    break;
+                new_entry((unsigned) r.hr_value,
+                        r.hr_time < 0 ? -1
+                        : r.hr_time > now ? now : (time_t) r.hr_time,
+                        payload);
+                break;
+            case 'c':
+                remove_last_entry();
+                break;
+            case 'd':
+                if (r.hr_value >= 0)
+                    remove_entry_numbered((unsigned long) r.hr_value);
+                break;
+            case 'p':
+                if (r.hr_value > 0)
+                    add_histfile_pid((pid_t) r.hr_value);
+                else if (r.hr_value < 0)
+                    remove_histfile_pid((pid_t) -r.hr_value);
+                break;
+        }
+        pos += HISTBIN_RECORD_SIZE(r.hr_length);
+    }
+
+    munmap((void *) map, size);
+    histfilepos = (off_t) pos;
+    histfilegarbage = (pos < size);
+    return true;
 }
 
 void parse_history_entry(const wchar_t *line)
@@ -779,6 +1226,14 @@ void parse_removed_entry(const wchar_t *numstr)
     num = wcstoul(numstr, &end, 0x10);
     if (errno || (*end != L'\0' && !iswspace(*end)))
         return;
+    remove_entry_numbered(num);
+}
+
+/* Removes the entry that has the specified number, if any. */
+void remove_entry_numbered(unsigned long num)
+{
+    if (histlist.count == 0)
+        return;
     if (num > max_number)
         return;
 
@@ -820,8 +1275,9 @@ void parse_process_id(const wchar_t *numstr)
  * This function must be called just before writing to the history file. */
 void update_history(bool refresh)
 {
-    bool posfail;
+    bool posfail, wasbinary;
     fpos_t pos;
+    off_t binpos;
     long rev;
 
     if (histfile == NULL)
@@ -833,13 +1289,20 @@ void update_history(bool refresh)
 #else
     posfail = fgetpos(histfile, &pos);
 #endif
+    wasbinary = histfilebinary;
+    binpos = histfilepos;
     rev = read_signature();
     if (rev < 0)
         goto error;
-    if (!posfail && rev == histfilerev) {
+    if (rev == histfilerev && histfilebinary == wasbinary
+            && (histfilebinary || !posfail)) {
         /* The revision has not been changed. Just read new entries. */
-        fsetpos(histfile, &pos);
-        read_history();
+        if (histfilebinary)
+            histfilepos = binpos;
+        else
+            fsetpos(histfile, &pos);
+        if (!read_history())
+            goto error;
     } else {
         /* The revision has been changed. Re-read everything. */
         clear_all_entries();
@@ -847,10 +1310,9 @@ void update_history(bool refresh)
         add_histfile_pid(shell_pid);
         histfilerev = rev;
         histfilelines = 0;
-        read_history();
+        if (!read_history())
+            goto error;
     }
-    if (ferror(histfile) || !feof(histfile))
-        goto error;
 
     if (refresh)
         maybe_refresh_file();
@@ -886,6 +1348,71 @@ int wprintf_histfile(const wchar_t *format, ...)
     return result;
 }
 
+/* Appends a record to `histfilebuf', which is written to the binary history
+ * file when the file is flushed. `payload' may be NULL. */
+void add_histbin_record(
+        char type, intmax_t value, time_t time, const char *payload)
+{
+    struct histbinrecord_T r;
+    memset(&r, 0, sizeof r);
+    r.hr_type = (uint8_t) type;
+    r.hr_length = (payload != NULL) ? strlen(payload) + 1 : 0;
+    r.hr_value = value;
+    r.hr_time = time;
+
+    size_t length = sb_ncat_force(&histfilebuf, (const char *) &r, sizeof r)
+        ->length;
+    if (payload != NULL)
+        sb_ncat_force(&histfilebuf, payload, r.hr_length);
+    length += HISTBIN_RECORD_SIZE(r.hr_length) - sizeof r;
+    while (histfilebuf.length < length)
+        sb_ccat(&histfilebuf, '\0');
+    histneedflush = true;
+}
+
+/* Writes the records in `histfilebuf' to the binary history file at
+ * `histfilepos' and truncates the file after them if needed. */
+void flush_histbin(void)
+{
+    int fd = fileno(histfile);
+    size_t done = 0;
+    while (done < histfilebuf.length) {
+        ssize_t n = pwrite(fd, &histfilebuf.contents[done],
+                histfilebuf.length - done, histfilepos + (off_t) done);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        done += (size_t) n;
+    }
+    histfilepos += (off_t) done;
+    sb_clear(&histfilebuf);
+
+    if (histfilegarbage) {
+        while (ftruncate(fd, histfilepos) < 0 && errno == EINTR);
+        histfilegarbage = false;
+    }
+}
+
+/* Writes a record of the specified type to the history file.
+ * `type' is one of 'c' (cancellation; `value' is ignored), 'd' (deletion of
+ * entry number `value'), and 'p' (process ID `value'). */
+void write_histfile_record(char type, intmax_t value)
+{
+    assert(histfile != NULL);
+    if (histfilebinary) {
+        add_histbin_record(type, value, -1, NULL);
+        return;
+    }
+    switch (type) {
+        case 'c':  wprintf_histfile(L"c\n");            break;
+        case 'd':  wprintf_histfile(L"d%jX\n", value);  break;
+        case 'p':  wprintf_histfile(L"p%jd\n", value);  break;
+        default:   assert(false);
+    }
+}
+
 /* Writes the signature with an incremented revision number, after emptying the
  * file. */
 /* This function does not return any error status. The caller should check
@@ -893,15 +1420,29 @@ int wprintf_histfile(const wchar_t *format, ...)
 void write_signature(void)
 {
     assert(histfile != NULL);
-    rewind(histfile);
+    if (!histfilebinary)
+        rewind(histfile);
     while (ftruncate(fileno(histfile), 0) < 0 && errno == EINTR);
 
     if (histfilerev < 0 || histfilerev == LONG_MAX)
         histfilerev = 0;
     else
         histfilerev++;
-    wprintf_histfile(L"#$# yash history v0 r%ld\n", histfilerev);
     histfilelines = 0;
+
+    if (histfilebinary) {
+        struct histbinheader_T header;
+        memset(&header, 0, sizeof header);
+        memcpy(header.hb_magic, HISTBIN_MAGIC, sizeof header.hb_magic);
+        header.hb_revision = histfilerev;
+        sb_clear(&histfilebuf);
+        sb_ncat_force(&histfilebuf, (const char *) &header, sizeof header);
+        histfilepos = 0;
+        histfilegarbage = false;
+        histneedflush = true;
+    } else {
+        wprintf_histfile(L"#$# yash history v0 r%ld\n", histfilerev);
+    }
 }
 
 /* Writes the specified entry to the history file. */
@@ -916,7 +1457,9 @@ void write_history_entry(const histentry_T *entry)
     if (xstrnlen(entry->value, LINE_MAX) >= LINE_MAX)
         return;
 
-    if (entry->time >= 0)
+    if (histfilebinary)
+        add_histbin_record('e', entry->number, entry->time, entry->value);
+    else if (entry->time >= 0)
         wprintf_histfile(L"%X:%lX %s\n",
                 entry->number, (unsigned long) entry->time, entry->value);
     else
@@ -966,21 +1509,24 @@ void maybe_init_history(void)
         if (xwcstoul(vhistrmdup, 10, &rmdup))
             histrmdup = (rmdup <= histsize) ? rmdup : histsize;
     }
+    if (histrmdup > 0)
+        ht_init(&histvalues, hashstr, htstrcmp);
 
     update_time();
 
     /* open the history file and read it */
     histfile = open_histfile();
     if (histfile != NULL) {
+        sb_init(&histfilebuf);
         lock_histfile(F_WRLCK);
         histfilerev = read_signature();
         if (histfilerev < 0) {
+            histfilebinary = false;
             rewind(histfile);
             read_history_raw();
             goto refresh;
         }
-        read_history();
-        if (ferror(histfile) || !feof(histfile)) {
+        if (!read_history()) {
             close_history_file();
             return;
         }
@@ -989,13 +1535,16 @@ void maybe_init_history(void)
         if (histfilepids.count == 0) {
             renumber_all_entries();
 refresh:
+            /* No other shell is using the file, so we can convert it to the
+             * format specified by the hist-binary option. */
+            histfilebinary = shopt_histbinary;
             refresh_file();
         } else {
             maybe_refresh_file();
         }
 
         add_histfile_pid(shell_pid);
-        wprintf_histfile(L"p%jd\n", (intmax_t) shell_pid);
+        write_histfile_record('p', shell_pid);
         histfilelines++;
 
         lock_histfile(F_UNLCK);
@@ -1014,7 +1563,7 @@ void finalize_history(void)
     update_time();
     update_history(true);
     if (histfile != NULL) {
-        wprintf_histfile(L"p%jd\n", (intmax_t) -shell_pid);
+        write_histfile_record('p', -(intmax_t) shell_pid);
         // histfilelines++;
         close_history_file();
     }
@@ -1030,6 +1579,11 @@ void close_history_file(void)
     /* By closing the file descriptor for the history file, the file is
      * automatically unlocked. */
     // lock_histfile(F_UNLCK);
+    if (histfilebinary && histneedflush) {
+        histneedflush = false;
+        flush_histbin();
+    }
+    sb_destroy(&histfilebuf);
     remove_shellfd(fileno(histfile));
     fclose(histfile);
     histfile = NULL;
@@ -1117,18 +1671,22 @@ void add_history_line(const wchar_t *line, size_t maxlen)
  * `histfile' must be locked and `update_history' must have been called. */
 void remove_duplicates(const char *line)
 {
-    histlink_T *l = histlist.Newest;
-    for (unsigned i = histrmdup; i > 0 && l != Histlist; i--) {
-        histlink_T *prev = l->prev;
-        histentry_T *e = ashistentry(l);
-        if (strcmp(e->value, line) == 0) {
-            if (histfile != NULL) {
-                wprintf_histfile(L"d%X\n", e->number);
-                histfilelines++;
-            }
-            remove_entry(e);
+    if (histrmdup == 0)
+        return;
+
+    /* Each removed entry was newer than the remaining duplicates, so the
+     * window shrinks by one for each removal. */
+    unsigned window = histrmdup;
+    histentry_T *e = ht_get(&histvalues, line).value;
+    while (e != NULL && window > 0 && entry_is_recent(e, window)) {
+        histentry_T *older = e->dupolder;
+        if (histfile != NULL) {
+            write_histfile_record('d', e->number);
+            histfilelines++;
         }
-        l = prev;
+        remove_entry(e);
+        window--;
+        e = older;
     }
 }
 
@@ -1405,7 +1963,7 @@ void fc_remove_last_entry(void)
         update_history(true);
         remove_last_entry();
         if (histfile != NULL) {
-            wprintf_histfile(L"c\n");
+            write_histfile_record('c', 0);
             histfilelines++;
             lock_histfile(F_UNLCK);
         }
@@ -1784,7 +2342,7 @@ int history_delete(const wchar_t *s)
     if (l != Histlist) {
         histentry_T *e = ashistentry(l);
         if (histfile != NULL) {
-            wprintf_histfile(L"d%X\n", e->number);
+            write_histfile_record('d', e->number);
             histfilelines++;
         }
         remove_entry(e);
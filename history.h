@@ -34,6 +34,8 @@ typedef struct histlink_T {
 /* The structure type of history entries. */
 typedef struct histentry_T {
     histlink_T link;
+    struct histentry_T *dupolder, *dupnewer;
+    unsigned long serial;
     unsigned number;
     time_t time;
     char value[];
@@ -48,6 +50,11 @@ typedef struct histentry_T {
  * The limit is no less than $HISTSIZE, so all the entries have different
  * numbers anyway. */
 /* When the time is unknown, `time' is -1. */
+/* If duplicate removal is enabled ($HISTRMDUP is positive), entries that have
+ * the same value are linked in insertion order by `dupolder' and `dupnewer',
+ * which are NULL at the ends of the chain. */
+/* `serial' is increased for each entry added to the list. It never wraps
+ * around in practice and is used to estimate how new an entry is. */
 
 /* The structure type of the history list. */
 typedef struct histlist_T {
@@ -69,6 +76,14 @@ static inline histentry_T *ashistentry(const histlink_T *link)
     return (histentry_T *) link;
 }
 
+typedef struct histsearch_T histsearch_T;
+extern histsearch_T *histsearch_compile(const char *s)
+    __attribute__((nonnull,malloc,warn_unused_result));
+extern const histlink_T *histsearch_next(
+        const histsearch_T *search, const histlink_T *l, _Bool forward)
+    __attribute__((nonnull,pure));
+extern void histsearch_free(histsearch_T *search);
+
 extern unsigned next_history_number(void)
     __attribute__((pure));
 extern void maybe_init_history(void);
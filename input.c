@@ -438,9 +438,10 @@ void print_prompt(const wchar_t *s)
         return;
 #endif
 
+    wchar_t array[XWCSBUF_STACKSIZE];
     xwcsbuf_T buf;
 
-    wb_init(&buf);
+    wb_initwithstack(&buf, array, XWCSBUF_STACKSIZE);
     while (*s != L'\0') {
         if (*s != L'\\') {
             wb_wccat(&buf, *s);
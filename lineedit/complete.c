@@ -40,6 +40,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 #include <wchar.h>
 #include <wctype.h>
 #include <sys/stat.h>
@@ -111,7 +113,10 @@ static void select_candidate_by_offset(int offset);
 static void free_candidate(void *c)
     __attribute__((nonnull));
 static void free_context(le_context_T *ctxt);
+static bool is_completion_cancelled(void);
 static void sort_candidates(void);
+static const wchar_t *candidate_key(const void *cp)
+    __attribute__((nonnull,pure));
 static int sort_candidates_cmp(const void *cp1, const void *cp2)
     __attribute__((nonnull));
 static void print_context_info(const le_context_T *ctxt)
@@ -131,8 +136,19 @@ static bool le_wmatch_patterns(const le_comppattern_T *ps, const wchar_t *s)
     __attribute__((nonnull(2)));
 static void generate_file_candidates(const le_compopt_T *compopt)
     __attribute__((nonnull));
+static wchar_t *get_literal_prefix(const wchar_t *pattern)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static bool get_prefix_directory(const wchar_t *prefix, struct stat *st)
+    __attribute__((nonnull));
+static bool use_file_cache(const wchar_t *prefix, enum wglobflags_T flags)
+    __attribute__((nonnull));
+static void set_file_cache(wchar_t *prefix, enum wglobflags_T flags,
+        const struct stat *dirst, plist_T *files)
+    __attribute__((nonnull));
 static void generate_external_command_candidates(const le_compopt_T *compopt)
     __attribute__((nonnull));
+static void add_external_command_candidate(const char *name, void *compopt)
+    __attribute__((nonnull));
 static void generate_keyword_candidates(const le_compopt_T *compopt)
     __attribute__((nonnull));
 static void generate_logname_candidates(const le_compopt_T *compopt)
@@ -173,6 +189,19 @@ size_t le_selected_candidate_index;
  * The value is ((size_t) -1) when not computed. */
 static size_t common_prefix_length;
 
+/* The minimum interval in milliseconds between checks for pending input during
+ * candidate generation. */
+#define CANCEL_CHECK_INTERVAL 20
+
+/* True if the current completion can be cancelled by pending input. */
+static bool completion_cancellable;
+/* True if the current completion has been cancelled. */
+static bool completion_cancelled;
+#if defined _POSIX_MONOTONIC_CLOCK && _POSIX_MONOTONIC_CLOCK >= 0
+/* The time (CLOCK_MONOTONIC) when pending input was last checked. */
+static struct timespec last_cancel_check;
+#endif
+
 
 /* Performs command line completion.
  * Existing candidates are deleted, if any, and candidates are computed from
@@ -200,16 +229,30 @@ void le_complete(le_compresult_T lecr)
     pl_init(&le_candidates);
     common_prefix_length = (size_t) -1;
 
+    completion_cancellable = shopt_le_compcancel && !le_state_is_compdebug;
+    completion_cancelled = false;
+#if defined _POSIX_MONOTONIC_CLOCK && _POSIX_MONOTONIC_CLOCK >= 0
+    last_cancel_check.tv_sec = -1;
+#endif
+
     ctxt = le_get_context();
     if (le_state_is_compdebug)
         print_context_info(ctxt);
 
     execute_completion_function();
-    sort_candidates();
-    le_compdebug("total of %zu candidate(s)", le_candidates.length);
 
-    /* display the results */
-    lecr();
+    if (completion_cancelled) {
+        /* Discard the candidates and leave the command line intact. The
+         * interrupt flag was set only to stop the generation. */
+        le_complete_cleanup();
+        reset_interrupted();
+    } else {
+        sort_candidates();
+        le_compdebug("total of %zu candidate(s)", le_candidates.length);
+
+        /* display the results */
+        lecr();
+    }
 
     if (le_state_is_compdebug) {
         le_compdebug("completion end");
@@ -351,6 +394,8 @@ bool le_complete_fix_candidate(int index)
 {
     if (le_candidates.contents == NULL) {
         le_complete(lecr_nop);
+        if (le_candidates.contents == NULL)  /* cancelled */
+            return false;
         le_selected_candidate_index = le_candidates.length;
         le_display_make_rawvalues();
     }
@@ -414,11 +459,60 @@ void free_context(le_context_T *ctxt)
     }
 }
 
-/* Sorts the candidates in the candidate list and removes duplicates. */
+/* Tests if the current completion has been cancelled.
+ * If the `le-comp-cancel' option was set when the completion started, this
+ * function checks if the user has typed anything since then, at most once in
+ * CANCEL_CHECK_INTERVAL milliseconds. If there is pending input, the completion
+ * is cancelled and the interrupt flag is set so that pathname expansion and
+ * completion functions in progress stop as they would on SIGINT.
+ * Candidate generators call this function between (possibly slow) steps and
+ * stop generating candidates when it returns true. */
+bool is_completion_cancelled(void)
+{
+    if (completion_cancelled)
+        return true;
+    if (!completion_cancellable)
+        return false;
+
+#if defined _POSIX_MONOTONIC_CLOCK && _POSIX_MONOTONIC_CLOCK >= 0
+    struct timespec now;
+    if (clock_gettime(CLOCK_MONOTONIC, &now) >= 0) {
+        if (last_cancel_check.tv_sec >= 0) {
+            long elapsed = (long) (now.tv_sec - last_cancel_check.tv_sec) * 1000
+                + (now.tv_nsec - last_cancel_check.tv_nsec) / 1000000;
+            if (0 <= elapsed && elapsed < CANCEL_CHECK_INTERVAL)
+                return false;
+        }
+        last_cancel_check = now;
+    }
+#endif
+
+    if (!le_input_pending())
+        return false;
+
+    completion_cancelled = true;
+    set_interrupted();
+    return true;
+}
+
+/* Sorts the candidates in the candidate list and removes duplicates.
+ * Candidates that start with a hyphen come after the others, so the others are
+ * simply sorted by collation keys. */
 void sort_candidates(void)
 {
-    qsort(le_candidates.contents,
-            le_candidates.length, sizeof *le_candidates.contents,
+    size_t plain = 0;
+    for (size_t i = 0; i < le_candidates.length; i++) {
+        le_candidate_T *cand = le_candidates.contents[i];
+        if (cand->origvalue[0] != L'-') {
+            le_candidates.contents[i] = le_candidates.contents[plain];
+            le_candidates.contents[plain] = cand;
+            plain++;
+        }
+    }
+    collsort(le_candidates.contents,
+            plain, sizeof *le_candidates.contents, candidate_key);
+    qsort(&le_candidates.contents[plain],
+            le_candidates.length - plain, sizeof *le_candidates.contents,
             sort_candidates_cmp);
 
     if (le_candidates.length >= 2) {
@@ -434,6 +528,13 @@ void sort_candidates(void)
     }
 }
 
+/* Returns the value of the candidate (const le_candidate_T **) `cp' that
+ * determines the sort order. */
+const wchar_t *candidate_key(const void *cp)
+{
+    return (*(const le_candidate_T *const *) cp)->origvalue;
+}
+
 int sort_candidates_cmp(const void *cp1, const void *cp2)
 {
     const le_candidate_T *cand1 = *(const le_candidate_T **) cp1;
@@ -677,6 +778,9 @@ void simple_completion(le_candgentype_T type)
  * set to NULL. */
 void generate_candidates(const le_compopt_T *compopt)
 {
+    if (is_completion_cancelled())
+        goto end;
+
     generate_file_candidates(compopt);
     generate_builtin_candidates(compopt);
     generate_external_command_candidates(compopt);
@@ -692,6 +796,7 @@ void generate_candidates(const le_compopt_T *compopt)
     generate_bindkey_candidates(compopt);
     generate_dirstack_candidates(compopt);
 
+end:
     for (const le_comppattern_T *p = compopt->patterns; p != NULL; p = p->next)
         xfnm_free(p->cpattern);
 }
@@ -859,6 +964,33 @@ bool le_wmatch_comppatterns(const le_compopt_T *compopt, const wchar_t *s)
     return le_wmatch_patterns(compopt->patterns, s);
 }
 
+/* A file found by pathname expansion for file name candidates. */
+struct foundfile_T {
+    bool is_executable;
+    mode_t mode;
+    nlink_t nlink;
+    off_t size;
+    wchar_t name[];
+};
+
+/* Cache of files found for file name candidates.
+ * When the pattern for file name candidates is a literal prefix followed by an
+ * asterisk, the files found in the directory are saved here so that repeated
+ * completion in the same directory, including completion with a longer prefix,
+ * filters the saved files instead of searching the directory again.
+ * The cache is valid while the directory is not modified. It is cleared when
+ * line-editing finishes, so attributes of the files themselves are not checked
+ * for changes. */
+static struct {
+    wchar_t *prefix;          /* literal prefix or NULL if no cache */
+    size_t dirlength;         /* length of directory part of `prefix' */
+    enum wglobflags_T flags;  /* flags passed to `wglob' */
+    dev_t dev;                /* device ID of the directory */
+    ino_t ino;                /* i-node number of the directory */
+    time_t mtime;             /* last modified time of the directory */
+    plist_T files;            /* list of `struct foundfile_T *' */
+} filecache = { .prefix = NULL, };
+
 /* Generates file name candidates.
  * The CGT_FILE, CGT_DIRECTORY, and CGT_EXECUTABLE flags specify what candidate
  * to generate. The other flags are ignored. */
@@ -879,53 +1011,206 @@ void generate_file_candidates(const le_compopt_T *compopt)
     const le_comppattern_T *p = compopt->patterns;
     assert(p->type == CPT_ACCEPT);
 
-    /* generate candidates by wglob */
-    plist_T list;
-    wglob(p->pattern, flags, pl_init(&list));
-    p = p->next;
-
-    /* check pathnames in `list' and add them to the candidate list */
-    for (size_t i = 0; i < list.length; i++) {
-        wchar_t *name = list.contents[i];
-        if (p != NULL) {
-            const wchar_t *basename = wcsrchr(name, L'/');
-            if (basename == NULL)
-                basename = name;
-            if (!le_wmatch_patterns(p, basename)) {
+    wchar_t *prefix = get_literal_prefix(p->pattern);
+    plist_T *files, newfiles;
+    if (prefix != NULL && use_file_cache(prefix, flags)) {
+        le_compdebug("  using cached files for \"%ls\"", filecache.prefix);
+        files = &filecache.files;
+        p = p->next;
+    } else {
+        /* generate candidates by wglob */
+        plist_T list;
+        wglob(p->pattern, flags, pl_init(&list));
+        p = p->next;
+
+        /* Stat the pathnames in `list'. If the result is to be cached, all the
+         * pathnames are included regardless of the other patterns. */
+        struct stat dirst;
+        bool cache = prefix != NULL && get_prefix_directory(prefix, &dirst);
+        files = pl_init(&newfiles);
+        for (size_t i = 0; i < list.length; i++) {
+            wchar_t *name = list.contents[i];
+            if (is_completion_cancelled()) {
+                cache = false;
                 free(name);
                 continue;
             }
-        }
+            if (!cache && p != NULL) {
+                const wchar_t *basename = wcsrchr(name, L'/');
+                if (basename == NULL)
+                    basename = name;
+                if (!le_wmatch_patterns(p, basename)) {
+                    free(name);
+                    continue;
+                }
+            }
 
-        char *mbsname = malloc_wcstombs(name);
-        struct stat st;
-        if (mbsname != NULL &&
-                (stat(mbsname, &st) >= 0 || lstat(mbsname, &st) >= 0)) {
-            bool executable = S_ISREG(st.st_mode) && is_executable(mbsname);
-            if ((compopt->type & CGT_FILE)
-                    || ((compopt->type & CGT_DIRECTORY) && S_ISDIR(st.st_mode))
-                    || ((compopt->type & CGT_EXECUTABLE) && executable)) {
-                le_candidate_T *cand = xmalloc(sizeof *cand);
-                cand->type = CT_FILE;
-                cand->value = name;
-                cand->rawvalue.raw = NULL;
-                cand->rawvalue.width = 0;
-                cand->desc = NULL;
-                cand->rawdesc.raw = NULL;
-                cand->rawdesc.width = 0;
-                cand->appendage.filestat.is_executable = executable;
-                cand->appendage.filestat.mode = st.st_mode;
-                cand->appendage.filestat.nlink = st.st_nlink;
-                cand->appendage.filestat.size = st.st_size;
-                le_add_candidate(cand, compopt);
-                name = NULL;
+            char *mbsname = malloc_wcstombs(name);
+            struct stat st;
+            if (mbsname != NULL &&
+                    (stat(mbsname, &st) >= 0 || lstat(mbsname, &st) >= 0)) {
+                size_t namelen = wcslen(name);
+                struct foundfile_T *f = xmallocs(sizeof *f,
+                        add(namelen, 1), sizeof *f->name);
+                f->is_executable =
+                    S_ISREG(st.st_mode) && is_executable(mbsname);
+                f->mode = st.st_mode;
+                f->nlink = st.st_nlink;
+                f->size = st.st_size;
+                wmemcpy(f->name, name, namelen + 1);
+                pl_add(&newfiles, f);
             }
+            free(name);
+            free(mbsname);
+        }
+        pl_destroy(&list);
+
+        if (cache) {
+            set_file_cache(prefix, flags, &dirst, &newfiles);
+            files = &filecache.files;
+            prefix = NULL;
         }
-        free(name);
-        free(mbsname);
     }
 
-    pl_destroy(&list);
+    /* check files in `files' and add them to the candidate list */
+    for (size_t i = 0; i < files->length; i++) {
+        const struct foundfile_T *f = files->contents[i];
+        if (prefix != NULL && !matchwcsprefix(f->name, prefix))
+            continue;
+        if (p != NULL) {
+            const wchar_t *basename = wcsrchr(f->name, L'/');
+            if (basename == NULL)
+                basename = f->name;
+            if (!le_wmatch_patterns(p, basename))
+                continue;
+        }
+        if ((compopt->type & CGT_FILE)
+                || ((compopt->type & CGT_DIRECTORY) && S_ISDIR(f->mode))
+                || ((compopt->type & CGT_EXECUTABLE) && f->is_executable)) {
+            le_candidate_T *cand = xmalloc(sizeof *cand);
+            cand->type = CT_FILE;
+            cand->value = xwcsdup(f->name);
+            cand->rawvalue.raw = NULL;
+            cand->rawvalue.width = 0;
+            cand->desc = NULL;
+            cand->rawdesc.raw = NULL;
+            cand->rawdesc.width = 0;
+            cand->appendage.filestat.is_executable = f->is_executable;
+            cand->appendage.filestat.mode = f->mode;
+            cand->appendage.filestat.nlink = f->nlink;
+            cand->appendage.filestat.size = f->size;
+            le_add_candidate(cand, compopt);
+        }
+    }
+
+    if (files == &newfiles)
+        plfree(pl_toary(&newfiles), free);
+    free(prefix);
+}
+
+/* If `pattern' is a literal string followed by an asterisk, returns the
+ * literal string with backslash escapes removed. Otherwise, returns NULL.
+ * The result must be freed by the caller. */
+wchar_t *get_literal_prefix(const wchar_t *pattern)
+{
+    size_t len = wcslen(pattern);
+    if (len == 0 || pattern[len - 1] != L'*')
+        return NULL;
+
+    /* make sure the asterisk is not escaped */
+    size_t backslashes = 0;
+    while (backslashes < len - 1 && pattern[len - 2 - backslashes] == L'\\')
+        backslashes++;
+    if (backslashes % 2 != 0)
+        return NULL;
+
+    wchar_t *literal = xwcsndup(pattern, len - 1);
+    wchar_t *result = is_pathname_matching_pattern(literal)
+        ? NULL : unescape(literal);
+    free(literal);
+    return result;
+}
+
+/* Gets the status of the directory part of `prefix' into `*st'.
+ * Returns false if the status cannot be obtained or if the directory has been
+ * modified too recently to reliably detect later modification by the last
+ * modified time. */
+bool get_prefix_directory(const wchar_t *prefix, struct stat *st)
+{
+    const wchar_t *slash = wcsrchr(prefix, L'/');
+    char *dirname;
+    if (slash == NULL)
+        dirname = xstrdup(".");
+    else if (slash == prefix)
+        dirname = xstrdup("/");
+    else
+        dirname = malloc_wcsntombs(prefix, slash - prefix);
+    if (dirname == NULL)
+        return false;
+
+    bool ok = stat(dirname, st) >= 0;
+    free(dirname);
+    if (!ok)
+        return false;
+
+    time_t now = time(NULL);
+    return now != (time_t) -1 && st->st_mtime < now - 1;
+}
+
+/* Tests if the file cache can be used to generate file name candidates for
+ * the specified literal prefix. The cache can be used if it was made with the
+ * same flags for a prefix that the specified prefix starts with and the
+ * directory has not been modified since then. */
+bool use_file_cache(const wchar_t *prefix, enum wglobflags_T flags)
+{
+    if (filecache.prefix == NULL || filecache.flags != flags)
+        return false;
+    if (matchwcsprefix(prefix, filecache.prefix) == NULL)
+        return false;
+
+    /* The new prefix must be in the same directory. */
+    const wchar_t *basename = &prefix[filecache.dirlength];
+    if (wcschr(basename, L'/') != NULL)
+        return false;
+
+    /* Files whose name starts with a period are not in the cache unless the
+     * cached prefix includes the period or the WGLB_PERIOD flag is set. */
+    if (basename[0] == L'.' && filecache.prefix[filecache.dirlength] == L'\0'
+            && !(flags & WGLB_PERIOD))
+        return false;
+
+    struct stat st;
+    return get_prefix_directory(prefix, &st)
+        && st.st_dev == filecache.dev && st.st_ino == filecache.ino
+        && st.st_mtime == filecache.mtime;
+}
+
+/* Replaces the file cache with the specified files. The arguments are saved in
+ * the cache: `prefix' is freed and `files' is destroyed when the cache is
+ * cleared. */
+void set_file_cache(wchar_t *prefix, enum wglobflags_T flags,
+        const struct stat *dirst, plist_T *files)
+{
+    le_complete_clear_cache();
+
+    const wchar_t *slash = wcsrchr(prefix, L'/');
+    filecache.prefix = prefix;
+    filecache.dirlength = (slash == NULL) ? 0 : (size_t) (slash - prefix + 1);
+    filecache.flags = flags;
+    filecache.dev = dirst->st_dev;
+    filecache.ino = dirst->st_ino;
+    filecache.mtime = dirst->st_mtime;
+    filecache.files = *files;
+}
+
+/* Clears the cache of files for file name candidates. */
+void le_complete_clear_cache(void)
+{
+    if (filecache.prefix != NULL) {
+        free(filecache.prefix);
+        filecache.prefix = NULL;
+        plfree(pl_toary(&filecache.files), free);
+    }
 }
 
 /* Generates candidates that are the names of external commands matching the
@@ -940,6 +1225,9 @@ void generate_external_command_candidates(const le_compopt_T *compopt)
     if (!le_compile_cpatterns(compopt))
         return;
 
+    if (foreach_cmdindex_name(add_external_command_candidate, (void *) compopt))
+        return;
+
     char *const *paths = get_path_array(PA_PATH);
     xstrbuf_T path;
 
@@ -947,6 +1235,9 @@ void generate_external_command_candidates(const le_compopt_T *compopt)
         return;
     sb_init(&path);
     for (const char *dirpath; (dirpath = *paths) != NULL; paths++) {
+        if (is_completion_cancelled())
+            break;
+
         DIR *dir = opendir(dirpath);
         struct dirent *de;
         size_t dirpathlen;
@@ -957,7 +1248,7 @@ void generate_external_command_candidates(const le_compopt_T *compopt)
         if (path.length > 0 && path.contents[path.length - 1] != '/')
             sb_ccat(&path, '/');
         dirpathlen = path.length;
-        while ((de = readdir(dir)) != NULL) {
+        while (!is_completion_cancelled() && (de = readdir(dir)) != NULL) {
             if (!le_match_comppatterns(compopt, de->d_name))
                 continue;
             sb_cat(&path, de->d_name);
@@ -972,6 +1263,14 @@ void generate_external_command_candidates(const le_compopt_T *compopt)
     sb_destroy(&path);
 }
 
+/* Adds the specified command name as a candidate if it matches the pattern.
+ * `compopt' is a pointer to `le_compopt_T'. */
+void add_external_command_candidate(const char *name, void *compopt)
+{
+    if (le_match_comppatterns(compopt, name))
+        le_new_candidate(CT_COMMAND, malloc_mbstowcs(name), NULL, compopt);
+}
+
 /* Generates candidates that are keywords matching the pattern. */
 void generate_keyword_candidates(const le_compopt_T *compopt)
 {
@@ -1007,7 +1306,7 @@ void generate_logname_candidates(const le_compopt_T *compopt)
 
     struct passwd *pwd;
     setpwent();
-    while ((pwd = getpwent()) != NULL)
+    while (!is_completion_cancelled() && (pwd = getpwent()) != NULL)
         if (le_match_comppatterns(compopt, pwd->pw_name))
             le_new_candidate(CT_LOGNAME, malloc_mbstowcs(pwd->pw_name),
 # if HAVE_PW_GECOS
@@ -1035,7 +1334,7 @@ void generate_group_candidates(const le_compopt_T *compopt)
 
     struct group *grp;
     setgrent();
-    while ((grp = getgrent()) != NULL)
+    while (!is_completion_cancelled() && (grp = getgrent()) != NULL)
         if (le_match_comppatterns(compopt, grp->gr_name))
             le_new_candidate(
                     CT_GRP, malloc_mbstowcs(grp->gr_name), NULL, compopt);
@@ -1059,7 +1358,7 @@ void generate_host_candidates(const le_compopt_T *compopt)
 
     struct hostent *host;
     sethostent(true);
-    while ((host = gethostent()) != NULL) {
+    while (!is_completion_cancelled() && (host = gethostent()) != NULL) {
         if (le_match_comppatterns(compopt, host->h_name))
             le_new_candidate(
                     CT_HOSTNAME, malloc_mbstowcs(host->h_name), NULL, compopt);
@@ -41,6 +41,7 @@ typedef enum le_candtype_T {
 } le_candtype_T;
 typedef struct le_rawvalue_T {
     char *raw;       // pre-printed version of candidate value/description
+                     // or NULL if not yet printed
     int width;       // screen width of `raw'
 } le_rawvalue_T;
 typedef struct le_candidate_T {
@@ -193,6 +194,7 @@ extern void le_complete_select_column(int offset);
 extern void le_complete_select_page(int offset);
 extern _Bool le_complete_fix_candidate(int index);
 extern void le_complete_cleanup(void);
+extern void le_complete_clear_cache(void);
 extern void le_compdebug(const char *format, ...)
     __attribute__((nonnull,format(printf,1,2)));
 
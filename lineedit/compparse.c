@@ -43,13 +43,35 @@ typedef struct cparseinfo_T {
     size_t bufindex;
     struct aliaslist_T *aliaslist;
     le_context_T *ctxt;
+    bool toplevel;
 } cparseinfo_T;
 /* The `buf' buffer contains the first `le_main_index' characters of the edit
- * buffer. During parsing, alias substitution may be performed on this buffer.
+ * buffer, or the part of them after the checkpoint the parser resumes from.
+ * During parsing, alias substitution may be performed on this buffer.
  * The `bufindex' index indicates the point the parser is currently parsing.
  * The `ctxt' member points to the structure in which the final result is saved.
+ * The `toplevel' flag is true iff the parser is not inside any nested commands.
  */
 
+/* This structure contains the checkpoints of the last parse, which are reused
+ * in the next call to `le_get_context'. */
+static struct {
+    xwcsbuf_T text;
+    size_t *indices;
+    size_t count, max;
+    bool posix;
+} checkpoints;
+/* A checkpoint is an index into the edit buffer just after a command separator
+ * at the top level, where the parser state is nothing but the index itself.
+ * The `indices' array contains `count' checkpoints in ascending order. The
+ * array is allocated for `max' checkpoints.
+ * The `text' buffer contains the edit buffer contents up to the last
+ * checkpoint, which is compared with the current contents to find which
+ * checkpoints are still valid.
+ * The `posix' flag is the value of `posixly_correct' in the last parse.
+ * The checkpoints are kept during a line-editing session, during which alias
+ * definitions are assumed unchanged. */
+
 /* This structure contains data used during parsing */
 static cparseinfo_T *pi;
 
@@ -58,6 +80,9 @@ static cparseinfo_T *pi;
 #define INDEX (pi->bufindex)
 
 
+static size_t resume_from_checkpoint(void);
+static void save_checkpoint(void);
+static void update_checkpoint_text(void);
 static void empty_pwords(void);
 static void set_pwords(plist_T *pwords)
     __attribute__((nonnull));
@@ -106,22 +131,26 @@ static bool remove_braceexpand_inner(xwcsbuf_T *buf, size_t *index)
     __attribute__((nonnull));
 
 
-/* Parses the contents of the edit buffer (`le_main_buffer') from the beginning
- * up to the current cursor position (`le_main_index') and determines the
- * current completion context.
+/* Parses the contents of the edit buffer (`le_main_buffer') up to the current
+ * cursor position (`le_main_index') and determines the current completion
+ * context. The parser resumes from the last checkpoint that is still valid
+ * rather than from the beginning of the buffer.
  * The results are returned as a newly malloced `le_context_T' data. */
 le_context_T *le_get_context(void)
 {
     assert(wcslen(le_main_buffer.contents) == le_main_buffer.length);
 
     le_context_T *ctxt = xmalloc(sizeof *ctxt);
+    size_t start = resume_from_checkpoint();
 
     cparseinfo_T parseinfo;
-    wb_initwithmax(&parseinfo.buf, le_main_index);
-    wb_ncat_force(&parseinfo.buf, le_main_buffer.contents, le_main_index);
+    wb_initwithmax(&parseinfo.buf, le_main_index - start);
+    wb_ncat_force(&parseinfo.buf,
+            &le_main_buffer.contents[start], le_main_index - start);
     parseinfo.bufindex = 0;
     parseinfo.aliaslist = NULL;
     parseinfo.ctxt = ctxt;
+    parseinfo.toplevel = true;
 
     pi = &parseinfo;
     while (!cparse_commands())
@@ -132,6 +161,7 @@ le_context_T *le_get_context(void)
 
     wb_destroy(&parseinfo.buf);
     destroy_aliaslist(parseinfo.aliaslist);
+    update_checkpoint_text();
 
     if (shopt_braceexpand)
         if (remove_braceexpand(ctxt->pattern))
@@ -152,6 +182,82 @@ le_context_T *le_get_context(void)
     return ctxt;
 }
 
+/* Discards the checkpoints that are invalidated by changes in the edit buffer
+ * and returns the last remaining checkpoint, which is zero if none remains. */
+size_t resume_from_checkpoint(void)
+{
+    size_t valid = 0;
+    if (checkpoints.text.contents == NULL)
+        wb_init(&checkpoints.text);
+    else if (checkpoints.posix == posixly_correct) {
+        const wchar_t *text = checkpoints.text.contents;
+        size_t length = checkpoints.text.length;
+        if (length > le_main_index)
+            length = le_main_index;
+        while (valid < length && text[valid] == le_main_buffer.contents[valid])
+            valid++;
+    }
+    checkpoints.posix = posixly_correct;
+
+    while (checkpoints.count > 0
+            && checkpoints.indices[checkpoints.count - 1] > valid)
+        checkpoints.count--;
+
+    size_t start = (checkpoints.count > 0)
+        ? checkpoints.indices[checkpoints.count - 1] : 0;
+    wb_truncate(&checkpoints.text, start);
+    return start;
+}
+
+/* Records the current position as a checkpoint unless it is in the result of
+ * alias substitution.
+ * This function must be called just after a command separator is parsed at the
+ * top level. */
+void save_checkpoint(void)
+{
+    if (!is_aliaslist_expired(pi->aliaslist, INDEX))
+        return;
+
+    /* The text after the current position is not changed by substitution, so
+     * the position in the edit buffer is counted from its end. */
+    size_t index = le_main_index - (LEN - INDEX);
+    if (checkpoints.count > 0
+            && checkpoints.indices[checkpoints.count - 1] >= index)
+        return;
+    if (checkpoints.count == checkpoints.max) {
+        checkpoints.max = (checkpoints.max == 0) ? 8 : checkpoints.max * 2;
+        checkpoints.indices = xreallocn(checkpoints.indices,
+                checkpoints.max, sizeof *checkpoints.indices);
+    }
+    checkpoints.indices[checkpoints.count++] = index;
+}
+
+/* Copies the edit buffer contents up to the last checkpoint into
+ * `checkpoints.text'. */
+void update_checkpoint_text(void)
+{
+    if (checkpoints.count == 0)
+        return;
+
+    size_t end = checkpoints.indices[checkpoints.count - 1];
+    size_t length = checkpoints.text.length;
+    assert(length <= end);
+    wb_ncat_force(&checkpoints.text,
+            &le_main_buffer.contents[length], end - length);
+}
+
+/* Discards all the checkpoints. */
+void le_clear_context_cache(void)
+{
+    if (checkpoints.text.contents != NULL) {
+        wb_destroy(&checkpoints.text);
+        checkpoints.text.contents = NULL;
+    }
+    free(checkpoints.indices);
+    checkpoints.indices = NULL;
+    checkpoints.count = checkpoints.max = 0;
+}
+
 /* If `pi->ctxt->pwords' is NULL, assigns a new empty list to it. */
 void empty_pwords(void)
 {
@@ -182,13 +288,19 @@ void set_pwords(plist_T *pwords)
  * found or the whole line is parsed. */
 bool cparse_commands(void)
 {
+    bool toplevel = pi->toplevel;
+    pi->toplevel = false;
+
     for (;;) {
         skip_blanks();
         switch (BUF[INDEX]) {
             case L'\n':  case L';':  case L'&':  case L'|':
                 INDEX++;
+                if (toplevel)
+                    save_checkpoint();
                 continue;
             case L')':
+                pi->toplevel = toplevel;
                 return false;
         }
 
@@ -353,6 +465,9 @@ bool ctryparse_assignment(void)
         return false;
     while (is_name_char(BUF[index]))
         index++;
+    if (!posixly_correct && index > INDEX &&
+            BUF[index] == L'+' && BUF[index + 1] == L'=')
+        index++;
     if (BUF[index] != L'=')
         return false;
     INDEX = index + 1;
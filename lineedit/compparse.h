@@ -23,6 +23,7 @@
 struct le_context_T;
 extern struct le_context_T *le_get_context(void)
     __attribute__((malloc,warn_unused_result));
+extern void le_clear_context_cache(void);
 
 
 #endif /* YASH_COMPPARSE_H */
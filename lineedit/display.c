@@ -28,6 +28,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <wchar.h>
 #include <wctype.h>
@@ -339,6 +340,12 @@ static void clear_to_end_of_screen(void);
 static void clear_editline(void);
 static void maybe_print_promptsp(void);
 static void update_editline(void);
+static void print_editline(size_t index);
+static bool shift_editline(size_t index);
+static size_t style_offset(size_t boundary, size_t start, size_t length)
+    __attribute__((const));
+static void print_editline_cells(int from, int to, size_t index, size_t end);
+static void print_editline_range(size_t index, size_t end);
 static bool current_display_is_uptodate(size_t index)
     __attribute__((pure));
 static void check_cand_overwritten(void);
@@ -351,6 +358,14 @@ static void go_to_index(size_t index);
 static void go_to_after_editline(void);
 static void fillip_cursor(void);
 
+static const wchar_t *candidate_display_value(const le_candidate_T *cand)
+    __attribute__((nonnull,pure));
+static bool needs_hyphen(const le_candidate_T *cand)
+    __attribute__((nonnull,pure));
+static int display_width(const wchar_t *s)
+    __attribute__((nonnull,pure));
+static void make_rawvalue(le_candidate_T *cand)
+    __attribute__((nonnull));
 static void print_candidate_rawvalue(const le_candidate_T *cand)
     __attribute__((nonnull));
 static void update_candidates(void);
@@ -363,7 +378,7 @@ static void free_candcol(void *candcol)
     __attribute__((nonnull));
 static void print_candidates_all(void);
 static void update_highlighted_candidate(void);
-static void print_candidate(const le_candidate_T *cand, const candcol_T *col,
+static void print_candidate(le_candidate_T *cand, const candcol_T *col,
         bool highlight, bool printdesc)
     __attribute__((nonnull));
 static void print_candidate_count(size_t pageindex);
@@ -681,15 +696,48 @@ void update_editline(void)
                 && le_main_buffer.contents[index] == L'\0')
             return;
 
-        go_to_index(index);
-        if (current_editline[index] != L'\0')
+        if (current_editline[index] == L'\0') {
+            go_to_index(index);
+            print_editline(index);
+        } else if (!shift_editline(index)) {
+            go_to_index(index);
             clear_editline();
+            print_editline(index);
+        }
     } else {
         /* print the whole edit line */
         go_to(editbasepos);
         clear_editline();
+        print_editline(0);
     }
 
+    lebuf_print_sgr0(), styler_active = false;
+
+    current_length = le_main_length;
+
+    fillip_cursor();
+
+    last_edit_line =
+        (lebuf.pos.line >= rprompt_line) ? lebuf.pos.line : rprompt_line;
+
+    /* clear the right prompt if the edit line reaches it. */
+    if (rprompt_line == lebuf.pos.line
+            && lebuf.pos.column > lebuf.maxcolumn - rprompt.width - 2) {
+        lebuf_print_el();
+        rprompt_line = -1;
+    } else if (rprompt_line < lebuf.pos.line) {
+        rprompt_line = -1;
+    }
+
+    /* clear the remaining of the current line if we're overwriting the
+     * candidate area. */
+    check_cand_overwritten();
+}
+
+/* Prints the edit line from the specified index to the end.
+ * The cursor must be at the position of the index. */
+void print_editline(size_t index)
+{
     update_styler();
 
     // No need to check for overflow in `le_main_buffer.length + 1' here. Should
@@ -712,27 +760,192 @@ void update_editline(void)
         lebuf_putwchar(c, true);
         index++;
     }
-    lebuf_print_sgr0(), styler_active = false;
+}
 
-    current_length = le_main_length;
+/* Tries to update the edit line by shifting the unchanged part at the end of
+ * the line on the screen using the "ich" or "dch" capability, so that only the
+ * changed part and the characters that move across a line boundary need to be
+ * printed. `index' is the index of the first character that has been changed.
+ * Each screen line is shifted separately because the terminal does not move
+ * characters across line boundaries.
+ * Returns false without printing anything if this method is not applicable.
+ * In that case, the caller must reprint the rest of the edit line. */
+bool shift_editline(size_t index)
+{
+    if (rprompt_line >= 0)
+        return false;
 
-    fillip_cursor();
+    const wchar_t *newline = le_main_buffer.contents;
+    size_t oldlen = wcslen(current_editline), newlen = le_main_buffer.length;
+    const int w = lebuf.maxcolumn;
+
+    /* find the unchanged suffix */
+    size_t suffix = 0;
+    while (index + suffix < oldlen && index + suffix < newlen
+            && current_editline[oldlen - suffix - 1]
+                == newline[newlen - suffix - 1])
+        suffix++;
+    if (suffix == 0)
+        return false;
 
-    last_edit_line =
-        (lebuf.pos.line >= rprompt_line) ? lebuf.pos.line : rprompt_line;
+    size_t oldsuffix = oldlen - suffix, newsuffix = newlen - suffix;
+    if (style_offset(current_length, oldsuffix, suffix)
+            != style_offset(le_main_length, newsuffix, suffix))
+        return false;
 
-    /* clear the right prompt if the edit line reaches it. */
-    if (rprompt_line == lebuf.pos.line
-            && lebuf.pos.column > lebuf.maxcolumn - rprompt.width - 2) {
-        lebuf_print_el();
-        rprompt_line = -1;
-    } else if (rprompt_line < lebuf.pos.line) {
-        rprompt_line = -1;
+    /* compute the new position of the suffix. We give up if any character is
+     * not printable or does not fit in the rest of a line because the position
+     * of such a character does not shift uniformly. */
+    int start = cursor_positions[index], newstart = start;
+    for (size_t i = index; i < newsuffix; i++) {
+        int width = wcwidth(newline[i]);
+        if (width <= 0 || newstart % w + width > w)
+            return false;
+        newstart += width;
     }
 
-    /* clear the remaining of the current line if we're overwriting the
-     * candidate area. */
-    check_cand_overwritten();
+    int delta = newstart - cursor_positions[oldsuffix];
+    if (delta >= w || -delta >= w)
+        return false;
+    if ((delta > 0 && !le_ti_ich) || (delta < 0 && !le_ti_dch))
+        return false;
+
+    for (size_t i = oldsuffix; i < oldlen; i++) {
+        int width = wcwidth(current_editline[i]);
+        int pos = cursor_positions[i];
+        if (width <= 0 || cursor_positions[i + 1] - pos != width
+                || (pos + delta) % w + width > w)
+            return false;
+    }
+
+    int oldend = cursor_positions[oldlen], newend = oldend + delta;
+    int firstline = start / w;
+    int oldlastline = (oldend - 1) / w, newlastline = (newend - 1) / w;
+    int maxline = (line_max > lebuf.pos.line) ? line_max : lebuf.pos.line;
+    if (oldlastline > maxline || newlastline > maxline)
+        return false;
+
+    /* update `current_editline' and `cursor_positions' */
+    size_t maxlen = (oldlen > newlen) ? oldlen : newlen;
+    current_editline = xreallocn(current_editline,
+            maxlen + 1, sizeof *current_editline);
+    cursor_positions = xreallocn(cursor_positions,
+            maxlen + 1, sizeof *cursor_positions);
+    memmove(&current_editline[newsuffix], &current_editline[oldsuffix],
+            (suffix + 1) * sizeof *current_editline);
+    memmove(&cursor_positions[newsuffix], &cursor_positions[oldsuffix],
+            (suffix + 1) * sizeof *cursor_positions);
+    for (size_t i = newsuffix; i <= newlen; i++)
+        cursor_positions[i] += delta;
+    int pos = start;
+    for (size_t i = index; i < newsuffix; i++) {
+        current_editline[i] = newline[i];
+        cursor_positions[i] = pos;
+        pos += wcwidth(newline[i]);
+    }
+
+    /* Shift the characters on each line and print the characters that move
+     * from the adjacent line. The changed part is printed after all lines
+     * have been shifted. */
+    int lastline = (oldlastline > newlastline) ? oldlastline : newlastline;
+    for (int line = firstline; line <= lastline; line++) {
+        int linestart = line * w, lineend = linestart + w;
+        int from, to;
+        if (delta >= 0) {
+            if (delta > 0 && line <= oldlastline && newstart < lineend) {
+                go_to((le_pos_T) {
+                        line, (line == firstline) ? start % w : 0 });
+                lebuf_print_ich(delta);
+            }
+            from = linestart;
+            to = linestart + delta;
+            if (line == firstline)
+                continue;
+        } else {
+            if (line > newlastline) {
+                go_to((le_pos_T) { line, 0 });
+                lebuf_print_el();
+                continue;
+            }
+            from = (newstart > linestart) ? newstart : linestart;
+            if (from < lineend) {
+                go_to((le_pos_T) { line, from - linestart });
+                lebuf_print_dch(-delta);
+            }
+            to = lineend;
+            from = to + delta;
+        }
+        if (from < newstart)
+            from = newstart;
+        if (to > newend)
+            to = newend;
+        if (from < to)
+            print_editline_cells(from, to, newsuffix, newlen);
+    }
+
+    /* print the changed part */
+    go_to_index(index);
+    print_editline_range(index, newsuffix);
+
+    /* leave the cursor just after the last character as if the whole line
+     * were printed */
+    if (lebuf.pos.line * w + lebuf.pos.column != newend) {
+        go_to_index(newlen - 1);
+        print_editline_range(newlen - 1, newlen);
+    }
+
+    return true;
+}
+
+/* Returns the offset from `start' of the style boundary `boundary' (the index
+ * of the first predicted character), clamped to the range [0, length]. */
+size_t style_offset(size_t boundary, size_t start, size_t length)
+{
+    if (boundary <= start)
+        return 0;
+    if (boundary - start >= length)
+        return length;
+    return boundary - start;
+}
+
+/* Prints the characters of the edit line positioned in the range [from, to)
+ * of the cursor positions. The characters are searched for in the range
+ * [index, end) of the indices. */
+void print_editline_cells(int from, int to, size_t index, size_t end)
+{
+    /* binary search for the first character */
+    size_t lo = index, hi = end;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (cursor_positions[mid] < from)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    size_t first = lo;
+    while (lo < end && cursor_positions[lo] < to)
+        lo++;
+
+    go_to_index(first);
+    print_editline_range(first, lo);
+}
+
+/* Prints the characters in the range [index, end) of `current_editline'
+ * in the style appropriate for their positions relative to `le_main_length'.
+ * The cursor must be at the position of the first character. */
+void print_editline_range(size_t index, size_t end)
+{
+    for (size_t i = index; i < end; i++) {
+        if (i == index || i == le_main_length) {
+            if (i < le_main_length) {
+                update_styler();
+            } else {
+                lebuf_print_sgr0(), styler_active = false;
+                lebuf_print_prompt(prompt.predict);
+            }
+        }
+        lebuf_putwchar(current_editline[i], true);
+    }
 }
 
 bool current_display_is_uptodate(size_t index)
@@ -924,8 +1137,10 @@ void fillip_cursor(void)
 }
 
 
-/* Sets the `raw' and `width' members of candidates in `le_candidates'.
- * This function uses the print buffer to calculate the widths. */
+/* Sets the `width' members of candidates in `le_candidates'.
+ * The `raw' members are left NULL here and are made by `make_rawvalue' when
+ * the candidates are first printed, so that candidates that are never shown on
+ * the screen are not formatted. */
 void le_display_make_rawvalues(void)
 {
     assert(le_candidates.contents != NULL);
@@ -934,46 +1149,85 @@ void le_display_make_rawvalues(void)
         le_candidate_T *cand = le_candidates.contents[i];
 
         assert(cand->rawvalue.raw == NULL);
-        lebuf_init_with_max((le_pos_T) { 0, 0 }, -1);
-
-        print_candidate_rawvalue(cand);
-
-        cand->rawvalue.raw = sb_tostr(&lebuf.buf);
-        cand->rawvalue.width = lebuf.pos.column;
+        cand->rawvalue.width = display_width(candidate_display_value(cand));
+        if (needs_hyphen(cand))
+            cand->rawvalue.width += 1;
 
         assert(cand->rawdesc.raw == NULL);
-        if (cand->desc != NULL) {
-            lebuf_init_with_max((le_pos_T) { 0, 0 }, -1);
-
-            lebuf_putws_trunc(cand->desc);
-
-            cand->rawdesc.raw = sb_tostr(&lebuf.buf);
-            cand->rawdesc.width = lebuf.pos.column;
-        }
+        if (cand->desc != NULL)
+            cand->rawdesc.width = display_width(cand->desc);
     }
 }
 
-/* Prints the "raw value" of the specified candidate to the print buffer.
- * The output is truncated when the cursor reaches the end of the line. */
-void print_candidate_rawvalue(const le_candidate_T *cand)
+/* Returns the part of the value of the specified candidate that is shown in
+ * the candidate area. Directory components are skipped for a file candidate. */
+const wchar_t *candidate_display_value(const le_candidate_T *cand)
 {
     const wchar_t *s = cand->value;
 
     if (cand->type == CT_FILE) {
-        /* skip directory components for a file candidate */
         for (;;) {
             const wchar_t *ss = wcschr(s, L'/');
             if (ss == NULL || *++ss == L'\0')
                 break;
             s = ss;
         }
-    } else if (cand->type == CT_OPTION) {
-        /* prepend a hyphen if none */
-        if (cand->value[0] != L'-')
-            lebuf_putwchar_trunc(L'-');
+    }
+    return s;
+}
+
+/* Returns true iff a hyphen is prepended to the value of the specified
+ * candidate in the candidate area, that is, the candidate is an option that
+ * does not start with a hyphen. */
+bool needs_hyphen(const le_candidate_T *cand)
+{
+    return cand->type == CT_OPTION && cand->value[0] != L'-';
+}
+
+/* Returns the width of the specified string as printed by `lebuf_putws_trunc'
+ * with no limit of the line length. */
+int display_width(const wchar_t *s)
+{
+    int width = 0;
+    for (; *s != L'\0'; s++) {
+        int w = wcwidth(*s);
+        if (w > 0)
+            width += w;
+    }
+    return width;
+}
+
+/* Sets the `raw' members of the specified candidate if they are not yet set.
+ * The print buffer is preserved. */
+void make_rawvalue(le_candidate_T *cand)
+{
+    if (cand->rawvalue.raw != NULL)
+        return;
+
+    struct lebuf_T savelebuf = lebuf;
+
+    lebuf_init_with_max((le_pos_T) { 0, 0 }, -1);
+    print_candidate_rawvalue(cand);
+    cand->rawvalue.raw = sb_tostr(&lebuf.buf);
+    assert(cand->rawvalue.width == lebuf.pos.column);
+
+    if (cand->desc != NULL) {
+        lebuf_init_with_max((le_pos_T) { 0, 0 }, -1);
+        lebuf_putws_trunc(cand->desc);
+        cand->rawdesc.raw = sb_tostr(&lebuf.buf);
+        assert(cand->rawdesc.width == lebuf.pos.column);
     }
 
-    lebuf_putws_trunc(s);
+    lebuf = savelebuf;
+}
+
+/* Prints the "raw value" of the specified candidate to the print buffer.
+ * The output is truncated when the cursor reaches the end of the line. */
+void print_candidate_rawvalue(const le_candidate_T *cand)
+{
+    if (needs_hyphen(cand))
+        lebuf_putwchar_trunc(L'-');
+    lebuf_putws_trunc(candidate_display_value(cand));
 }
 
 /* Updates the candidate area.
@@ -1315,11 +1569,13 @@ void update_highlighted_candidate(void)
  * The candidate is highlighted iff `highlight' is true.
  * Iff `printdesc' is true, the candidate's description is printed.
  * The cursor is left just after the printed candidate. */
-void print_candidate(const le_candidate_T *cand, const candcol_T *col,
+void print_candidate(le_candidate_T *cand, const candcol_T *col,
         bool highlight, bool printdesc)
 {
     int line = lebuf.pos.line;
 
+    make_rawvalue(cand);
+
     /* print value */
     if (true /* cand->value != NULL */) {
         int base = lebuf.pos.column;
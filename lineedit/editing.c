@@ -37,6 +37,7 @@
 #include "../alias.h"
 #include "../exec.h"
 #include "../expand.h"
+#include "../hashtable.h"
 #include "../history.h"
 #include "../job.h"
 #include "../option.h"
@@ -48,6 +49,7 @@
 #include "../xfnmatch.h"
 #include "../yash.h"
 #include "complete.h"
+#include "compparse.h"
 #include "display.h"
 #include "keymap.h"
 #include "lineedit.h"
@@ -169,7 +171,12 @@ static struct {
     size_t length;
 } overwrite_save_buffer;
 
-/* History of the edit line between editing commands. */
+/* History of the edit line between editing commands.
+ * Each entry is the difference between the previous state and the state the
+ * entry represents, so that saving a state does not require copying the whole
+ * edit line. Some entries additionally have a copy of the whole edit line
+ * (checkpoint) from which states can be restored without applying many
+ * differences. The first entry always has a checkpoint. */
 static plist_T undo_history;
 /* Index of the current state in the history.
  * If the current state is the newest, the index is `undo_history.length'. */
@@ -179,11 +186,21 @@ static const histlink_T *undo_history_entry;
 /* The index that is to be the value of the `index' member of the next undo
  * history entry. */
 static size_t undo_save_index;
+/* Contents of the edit line in the state at `undo_index'. */
+static xwcsbuf_T undo_snapshot;
+/* Total length of differences saved since the last checkpoint. */
+static size_t undo_delta_length;
 /* Structure of history entries */
 struct undo_history {
-    size_t index;        /* index of the cursor */
-    wchar_t contents[];  /* contents of the edit line */
-    // `contents' is a copy of `le_main_buffer.contents' up to `le_main_length'.
+    size_t index;           /* index of the cursor */
+    size_t position;        /* index where the difference starts */
+    size_t removedlength;   /* length of the text removed */
+    size_t insertedlength;  /* length of the text inserted */
+    wchar_t *checkpoint;    /* contents of the edit line, or NULL */
+    wchar_t text[];
+    // `text' contains the removed text immediately followed by the inserted
+    // text. If `checkpoint' is non-null, it points to the null-terminated
+    // contents of the edit line that follows the inserted text in `text'.
 };
 
 #define KILL_RING_SIZE 32  /* must be power of 2 */
@@ -196,16 +213,27 @@ static size_t last_put_elem = 0;  /* < KILL_RING_SIZE */
 /* The position and length of the last put string. */
 static size_t last_put_range_start, last_put_range_length;
 
+/* The text being inserted by `le_insert_paste'. */
+static const wchar_t *pasted_text;
+
 /* Set to true if the next completion command should restart completion from
  * scratch. */
 static bool reset_completion;
 /* The next value of `reset_completion'. */
 static bool next_reset_completion;
 
-/* Probability distribution tree for command prediction. */
-static trie_T *prediction_tree = NULL;
+/* The number of prediction models that may be mixed in a prediction. */
+#define PREDICTION_ORDER 4
+struct predmodel_T;
+/* Prediction models that are mixed to predict the command being edited.
+ * These are set by `le_editing_init' and used in
+ * `update_buffer_with_prediction'. */
+static const trie_T *prediction_trees[PREDICTION_ORDER];
+static double prediction_weights[PREDICTION_ORDER];
+static size_t prediction_count = 0;
 
 
+static le_command_func_T insert_pasted_text;
 static void reset_state(void);
 static void reset_count(void);
 static int get_count(int default_value)
@@ -216,6 +244,9 @@ static void save_current_edit_command(void);
 static void save_current_find_command(void);
 static void save_undo_history(void);
 static void maybe_save_undo_history(void);
+static void save_undo_checkpoint(size_t index, const wchar_t *contents)
+    __attribute__((nonnull));
+static void apply_undo_history(size_t newindex);
 static void exec_motion_command(size_t new_index, bool inclusive);
 static void set_motion_expect_command(enum motion_expect_command_T cmd);
 static void exec_motion_expect_command(
@@ -295,9 +326,16 @@ static void cancel_undo(int offset);
 
 static void check_reset_completion(void);
 
-static void create_prediction_tree(void);
-static size_t count_matching_previous_commands(const histentry_T *e1)
-    __attribute__((nonnull,pure));
+static void build_prediction_models(void);
+static void destroy_prediction_models(void);
+static void add_prediction_sample(const histentry_T *e)
+    __attribute__((nonnull));
+static void remove_prediction_sample(size_t index);
+static struct predmodel_T *get_prediction_model(const char *context)
+    __attribute__((nonnull));
+static void rescale_prediction_model(struct predmodel_T *m)
+    __attribute__((nonnull));
+static void select_prediction_models(void);
 static void clear_prediction(void);
 static void update_buffer_with_prediction(void);
 
@@ -356,6 +394,7 @@ void le_editing_init(void)
 
     start_using_history();
     pl_init(&undo_history);
+    wb_init(&undo_snapshot);
     undo_index = 0;
     undo_save_index = le_main_index;
     undo_history_entry = Histlist;
@@ -367,8 +406,10 @@ void le_editing_init(void)
     set_overwriting(false);
 
     if (shopt_le_predict) {
-        create_prediction_tree();
+        select_prediction_models();
         update_buffer_with_prediction();
+    } else {
+        destroy_prediction_models();
     }
 }
 
@@ -379,14 +420,17 @@ wchar_t *le_editing_finalize(void)
     assert(le_search_buffer.contents == NULL);
 
     plfree(pl_toary(&undo_history), free);
+    wb_destroy(&undo_snapshot);
 
     le_complete_cleanup();
+    le_complete_clear_cache();
+    le_clear_context_cache();
 
     end_using_history();
     free(main_history_value);
 
     clear_prediction();
-    trie_destroy(prediction_tree), prediction_tree = NULL;
+    prediction_count = 0;
     wb_wccat(&le_main_buffer, L'\n');
     return wb_towcs(&le_main_buffer);
 }
@@ -425,6 +469,38 @@ void le_invoke_command(le_command_func_T *cmd, wchar_t arg)
             le_main_index--;
 }
 
+/* Inserts the text pasted by the user at the cursor position (or appends it
+ * to the search buffer if history search is active).
+ * The whole text is inserted in one command so that the line is redrawn only
+ * once and the insertion can be undone at once. */
+void le_insert_paste(const wchar_t *text)
+{
+    pasted_text = text;
+    le_invoke_command(insert_pasted_text, L'\0');
+    pasted_text = NULL;
+}
+
+/* Inserts `pasted_text'. This function is invoked as a command from
+ * `le_insert_paste'. */
+void insert_pasted_text(wchar_t c __attribute__((unused)))
+{
+    if (le_search_buffer.contents != NULL) {
+        wb_cat(&le_search_buffer, pasted_text);
+        update_search();
+        return;
+    }
+
+    ALERT_AND_RETURN_IF_PENDING;
+    clear_prediction();
+    maybe_save_undo_history();
+
+    wb_insert(&le_main_buffer, le_main_index, pasted_text);
+    le_main_index += wcslen(pasted_text);
+
+    reset_state();
+    maybe_save_undo_history();
+}
+
 /* Resets `state'. */
 void reset_state(void)
 {
@@ -496,23 +572,91 @@ void save_current_find_command(void)
 /* Saves the current contents of the edit line to the undo history.
  * History entries at the current `undo_index' and newer are removed before
  * saving the current. If `undo_history_entry' is different from
- * `main_history_entry', all undo history entries are removed. */
+ * `main_history_entry', all undo history entries are removed.
+ * If there are remaining entries, the difference between `undo_snapshot' and
+ * the edit line is saved. */
 void save_undo_history(void)
 {
     for (size_t i = undo_index; i < undo_history.length; i++)
         free(undo_history.contents[i]);
     pl_truncate(&undo_history, undo_index);
 
-    // No need to check for overflow in `len + 1' here. Should overflow occur,
-    // the buffer would not have been allocated successfully.
     size_t len = active_length();
-    struct undo_history *e = xmallocs(sizeof *e, len + 1, sizeof *e->contents);
+    if (undo_index == 0) {
+        wchar_t *contents = xwcsndup(le_main_buffer.contents, len);
+        save_undo_checkpoint(le_main_index, contents);
+        free(contents);
+        undo_history_entry = main_history_entry;
+        return;
+    }
+
+    /* find the changed range by skipping the common prefix and suffix */
+    const wchar_t *old = undo_snapshot.contents, *new = le_main_buffer.contents;
+    size_t oldlen = undo_snapshot.length;
+    size_t prefix = 0;
+    while (prefix < oldlen && prefix < len && old[prefix] == new[prefix])
+        prefix++;
+    size_t suffix = 0;
+    while (prefix + suffix < oldlen && prefix + suffix < len
+            && old[oldlen - suffix - 1] == new[len - suffix - 1])
+        suffix++;
+
+    size_t removedlength = oldlen - prefix - suffix;
+    size_t insertedlength = len - prefix - suffix;
+    size_t deltalength = add(removedlength, insertedlength);
+
+    /* Make a checkpoint when the differences saved since the last checkpoint
+     * get as long as the edit line so that restoring a state does not need too
+     * many differences applied while the checkpoints do not dominate memory
+     * usage. */
+    bool checkpoint = (undo_delta_length += deltalength) >= len;
+    size_t textlength = deltalength;
+    if (checkpoint)
+        textlength = add(textlength, add(len, 1));
+
+    struct undo_history *e =
+        xmallocs(sizeof *e, textlength, sizeof *e->text);
     e->index = le_main_index;
-    wcsncpy(e->contents, le_main_buffer.contents, len);
-    e->contents[len] = L'\0';
+    e->position = prefix;
+    e->removedlength = removedlength;
+    e->insertedlength = insertedlength;
+    wmemcpy(e->text, &old[prefix], removedlength);
+    wmemcpy(&e->text[removedlength], &new[prefix], insertedlength);
+    if (checkpoint) {
+        e->checkpoint = &e->text[deltalength];
+        wmemcpy(e->checkpoint, new, len);
+        e->checkpoint[len] = L'\0';
+        undo_delta_length = 0;
+    } else {
+        e->checkpoint = NULL;
+    }
     pl_add(&undo_history, e);
     assert(undo_index == undo_history.length - 1);
     undo_history_entry = main_history_entry;
+
+    wb_replace_force(&undo_snapshot, prefix, removedlength,
+            &new[prefix], insertedlength);
+}
+
+/* Saves the first entry of the undo history, which has the specified cursor
+ * index and contents as a checkpoint. The undo history must be empty. */
+void save_undo_checkpoint(size_t index, const wchar_t *contents)
+{
+    assert(undo_history.length == 0);
+
+    size_t len = wcslen(contents);
+    struct undo_history *e =
+        xmallocs(sizeof *e, add(len, 1), sizeof *e->text);
+    e->index = index;
+    e->position = 0;
+    e->removedlength = e->insertedlength = 0;
+    e->checkpoint = e->text;
+    wmemcpy(e->checkpoint, contents, len + 1);
+    pl_add(&undo_history, e);
+
+    wb_clear(&undo_snapshot);
+    wb_ncat_force(&undo_snapshot, contents, len);
+    undo_delta_length = 0;
 }
 
 /* Calls `save_undo_history' if the current contents of the edit line is not
@@ -528,8 +672,9 @@ void maybe_save_undo_history(void)
     if (undo_history_entry == main_history_entry) {
         if (undo_index < undo_history.length) {
             struct undo_history *h = undo_history.contents[undo_index];
-            if (wcsncmp(le_main_buffer.contents, h->contents, len) == 0 &&
-                    h->contents[len] == L'\0') {
+            if (len == undo_snapshot.length &&
+                    wmemcmp(le_main_buffer.contents,
+                        undo_snapshot.contents, len) == 0) {
                 /* The contents of the main buffer is the same as saved in the
                  * history. Just save the index. */
                 h->index = le_main_index;
@@ -546,19 +691,46 @@ void maybe_save_undo_history(void)
          * history entry, but it's not yet saved in the undo history. We first
          * save the original history value and then save the current buffer
          * contents. */
-        struct undo_history *h;
         pl_clear(&undo_history, free);
-        h = xmallocs(sizeof *h,
-                add(wcslen(main_history_value), 1), sizeof *h->contents);
         assert(save_undo_save_index <= wcslen(main_history_value));
-        h->index = save_undo_save_index;
-        wcscpy(h->contents, main_history_value);
-        pl_add(&undo_history, h);
+        save_undo_checkpoint(save_undo_save_index, main_history_value);
         undo_index = 1;
     }
     save_undo_history();
 }
 
+/* Changes `undo_snapshot' and `undo_index' to the state at `newindex' in the
+ * undo history by applying differences from the current state or the nearest
+ * preceding checkpoint, whichever requires fewer differences applied. */
+void apply_undo_history(size_t newindex)
+{
+    assert(newindex < undo_history.length);
+
+    const struct undo_history *h;
+    size_t cpindex = newindex;
+    while (h = undo_history.contents[cpindex], h->checkpoint == NULL)
+        cpindex--;
+
+    size_t distance = (undo_index <= newindex)
+        ? newindex - undo_index : undo_index - newindex;
+    if (newindex - cpindex < distance) {
+        wb_clear(&undo_snapshot);
+        wb_cat(&undo_snapshot, h->checkpoint);
+        undo_index = cpindex;
+    }
+
+    while (undo_index > newindex) {
+        h = undo_history.contents[undo_index--];
+        wb_replace_force(&undo_snapshot, h->position, h->insertedlength,
+                h->text, h->removedlength);
+    }
+    while (undo_index < newindex) {
+        h = undo_history.contents[++undo_index];
+        wb_replace_force(&undo_snapshot, h->position, h->removedlength,
+                &h->text[h->removedlength], h->insertedlength);
+    }
+}
+
 /* Applies the currently pending editing command to the range between the
  * current cursor index and the specified index. If no editing command is
  * pending, simply moves the cursor to the specified index. */
@@ -2240,6 +2412,7 @@ void cancel_undo(int offset)
 
     if (undo_history_entry != main_history_entry)
         goto error;
+    size_t newindex;
     if (offset < 0) {
         if (undo_index == 0)
             goto error;
@@ -2248,9 +2421,9 @@ void cancel_undo(int offset)
 #else
         if ((size_t) -offset > undo_index)
 #endif
-            undo_index = 0;
+            newindex = 0;
         else
-            undo_index += offset;
+            newindex = undo_index + offset;
     } else {
         if (undo_index + 1 >= undo_history.length)
             goto error;
@@ -2259,13 +2432,15 @@ void cancel_undo(int offset)
 #else
         if ((size_t) offset >= undo_history.length - undo_index)
 #endif
-            undo_index = undo_history.length - 1;
+            newindex = undo_history.length - 1;
         else
-            undo_index += offset;
+            newindex = undo_index + offset;
     }
+    apply_undo_history(newindex);
 
     const struct undo_history *entry = undo_history.contents[undo_index];
-    wb_replace(&le_main_buffer, 0, SIZE_MAX, entry->contents, SIZE_MAX);
+    wb_replace(&le_main_buffer, 0, SIZE_MAX,
+            undo_snapshot.contents, undo_snapshot.length);
     assert(entry->index <= le_main_buffer.length);
     le_main_index = entry->index;
 
@@ -2495,55 +2670,290 @@ void check_reset_completion(void)
 
 /********** Prediction Commands **********/
 
+/* The prediction feature maintains a set of probability distribution trees,
+ * each of which is built from the history entries that followed a particular
+ * context, that is, a sequence of up to (PREDICTION_ORDER - 1) commands.
+ * A model whose context matches the newest history entries contributes to the
+ * prediction in addition to the model for the empty context, which contains
+ * all the entries.
+ * The models are built when the prediction is first needed and are then kept
+ * up to date as history entries are added and removed, so that the prompt does
+ * not have to wait for the models to be rebuilt.
+ * Newer entries have more weight: the weight of each sample grows by a factor
+ * of (1 / PREDICTION_DECAY) for each newer sample added to the same model. */
+
 #ifndef MAX_PREDICTION_SAMPLE
 #define MAX_PREDICTION_SAMPLE 10000
 #endif /* ifndef MAX_PREDICTION_SAMPLE */
+#define PREDICTION_DECAY 0.995
+/* When the weight of a new sample would exceed this, the weights in the model
+ * are scaled down. */
+#define PREDICTION_MAX_WEIGHT 1e100
+
+/* A probability distribution tree of the commands that followed a context. */
+struct predmodel_T {
+    char *context;            /* the key in `prediction_models' */
+    trie_T *tree;
+    double nextweight;        /* the weight of the next sample */
+    size_t samplecount;       /* the number of samples in `tree' */
+};
 
-/* Create a probability distribution tree for command prediction based on the
- * current history. The result is set to `prediction_tree'. */
-void create_prediction_tree(void)
-{
-    trie_T *t = trie_create();
-#define N 4
-    size_t hits[N] = {0};
-    for (const histlink_T *l = Histlist; (l = l->prev) != Histlist; ) {
-        const histentry_T *e = (const histentry_T *) l;
-        size_t k = count_matching_previous_commands(e);
-        assert(k < N);
-        for (size_t i = 0; i <= k; i++)
-            hits[i]++;
-        if (hits[0] >= MAX_PREDICTION_SAMPLE)
+/* A history entry that has been added to prediction models. */
+struct predsample_T {
+    unsigned long serial;     /* the serial of the history entry */
+    wchar_t *command;         /* the value of the history entry */
+    /* The model for the context of `k' preceding commands is `models[k]', to
+     * which the command was added with the weight of `weights[k]'. */
+    struct predmodel_T *models[PREDICTION_ORDER];
+    double weights[PREDICTION_ORDER];
+};
+
+/* True if the prediction models reflect the current history. */
+static bool prediction_valid = false;
+/* Hashtable mapping context strings to prediction models (struct predmodel_T).
+ * A context string is the preceding commands joined with newlines, the nearest
+ * first. */
+static hashtable_T prediction_models;
+/* Array of the samples in the prediction models. The samples are sorted by
+ * serial. The valid samples are in the range of
+ * [prediction_sample_head, prediction_sample_tail). */
+static struct predsample_T *prediction_samples;
+static size_t prediction_sample_head, prediction_sample_tail;
+static size_t prediction_sample_capacity;
+
+/* Builds the prediction models from the newest MAX_PREDICTION_SAMPLE history
+ * entries. */
+void build_prediction_models(void)
+{
+    assert(!prediction_valid);
+
+    ht_init(&prediction_models, hashstr, htstrcmp);
+    prediction_sample_capacity = 2 * MAX_PREDICTION_SAMPLE;
+    prediction_samples =
+        xmallocn(prediction_sample_capacity, sizeof *prediction_samples);
+    prediction_sample_head = prediction_sample_tail = 0;
+    prediction_valid = true;
+
+    const histlink_T *l = Histlist;
+    for (size_t i = 0; i < MAX_PREDICTION_SAMPLE; i++) {
+        if (l->prev == Histlist)
             break;
+        l = l->prev;
+    }
+    for (; l != Histlist; l = l->next)
+        add_prediction_sample(ashistentry(l));
+}
+
+/* Frees the prediction models, if any. */
+void destroy_prediction_models(void)
+{
+    if (!prediction_valid)
+        return;
+
+    while (prediction_sample_head < prediction_sample_tail)
+        free(prediction_samples[prediction_sample_head++].command);
+    free(prediction_samples);
+
+    size_t i = 0;
+    kvpair_T kv;
+    while ((kv = ht_next(&prediction_models, &i)).key != NULL) {
+        struct predmodel_T *m = kv.value;
+        free(m->context);
+        trie_destroy(m->tree);
+        free(m);
+    }
+    ht_destroy(&prediction_models);
+
+    prediction_count = 0;
+    prediction_valid = false;
+}
+
+/* Called when the history entry `e' has been added as the newest. */
+void le_predict_add_history(const struct histentry_T *e)
+{
+    if (prediction_valid)
+        add_prediction_sample(e);
+}
+
+/* Called when the history entry `e' is about to be removed. */
+void le_predict_remove_history(const struct histentry_T *e)
+{
+    if (!prediction_valid)
+        return;
+
+    // binary search
+    size_t lo = prediction_sample_head, hi = prediction_sample_tail;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (prediction_samples[mid].serial < e->serial)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < prediction_sample_tail && prediction_samples[lo].serial == e->serial)
+        remove_prediction_sample(lo);
+}
 
-        wchar_t *cmd = malloc_mbstowcs(e->value);
-        if (cmd == NULL)
+/* Called when the history entries have been renumbered or cleared. The models
+ * are discarded and will be rebuilt when they are needed. */
+void le_predict_reset_history(void)
+{
+    destroy_prediction_models();
+}
+
+/* Adds the history entry `e' to the prediction models as the newest sample.
+ * The oldest sample is removed if there are too many samples. */
+void add_prediction_sample(const histentry_T *e)
+{
+    wchar_t *command = malloc_mbstowcs(e->value);
+    if (command == NULL)
+        return;
+
+    if (prediction_sample_tail - prediction_sample_head >= MAX_PREDICTION_SAMPLE)
+        remove_prediction_sample(prediction_sample_head);
+    if (prediction_sample_tail >= prediction_sample_capacity) {
+        memmove(prediction_samples, &prediction_samples[prediction_sample_head],
+                sizeof *prediction_samples
+                    * (prediction_sample_tail - prediction_sample_head));
+        prediction_sample_tail -= prediction_sample_head;
+        prediction_sample_head = 0;
+    }
+
+    struct predsample_T *s = &prediction_samples[prediction_sample_tail++];
+    s->serial = e->serial;
+    s->command = command;
+
+    xstrbuf_T context;
+    sb_init(&context);
+    const histlink_T *l = &e->link;
+    for (size_t k = 0; k < PREDICTION_ORDER; k++) {
+        if (k > 0) {
+            l = l->prev;
+            if (l == Histlist) {
+                s->models[k] = NULL;
+                continue;
+            }
+            if (k > 1)
+                sb_ccat(&context, '\n');
+            sb_cat(&context, ashistentry(l)->value);
+        }
+
+        struct predmodel_T *m = get_prediction_model(context.contents);
+        if (m->nextweight > PREDICTION_MAX_WEIGHT)
+            rescale_prediction_model(m);
+        s->models[k] = m;
+        s->weights[k] = m->nextweight;
+        m->tree = trie_add_probability(m->tree, command, m->nextweight);
+        m->samplecount++;
+        m->nextweight /= PREDICTION_DECAY;
+    }
+    sb_destroy(&context);
+}
+
+/* Removes the sample at the given index in `prediction_samples' from the
+ * prediction models. */
+void remove_prediction_sample(size_t index)
+{
+    struct predsample_T *s = &prediction_samples[index];
+    for (size_t k = 0; k < PREDICTION_ORDER; k++) {
+        struct predmodel_T *m = s->models[k];
+        if (m == NULL)
             continue;
-        t = trie_add_probability(t, cmd, 1.0 / (hits[k] + 1));
-        free(cmd);
+        if (--m->samplecount == 0) {
+            ht_remove(&prediction_models, m->context);
+            free(m->context);
+            trie_destroy(m->tree);
+            free(m);
+        } else {
+            // Weights are never less than 1, so nodes with a probability less
+            // than 0.5 are rounding errors left behind by removed samples.
+            m->tree = trie_subtract_probability(
+                    m->tree, s->command, s->weights[k], 0.5);
+        }
+    }
+    free(s->command);
+
+    if (index == prediction_sample_head) {
+        prediction_sample_head++;
+    } else {
+        memmove(s, s + 1,
+                sizeof *s * (prediction_sample_tail - index - 1));
+        prediction_sample_tail--;
     }
+}
 
-    prediction_tree = t;
+/* Returns the prediction model for the given context.
+ * A new empty model is created if there is none. */
+struct predmodel_T *get_prediction_model(const char *context)
+{
+    struct predmodel_T *m = ht_get(&prediction_models, context).value;
+    if (m == NULL) {
+        m = xmalloc(sizeof *m);
+        m->context = xstrdup(context);
+        m->tree = trie_create();
+        m->nextweight = 1.0;
+        m->samplecount = 0;
+        ht_set(&prediction_models, m->context, m);
+    }
+    return m;
 }
 
-// Counts N-1 at most
-size_t count_matching_previous_commands(const histentry_T *e)
+/* Scales down the weights in the given model so that the least weight of the
+ * samples is 1. */
+void rescale_prediction_model(struct predmodel_T *m)
 {
-    size_t count = 0;
-    const histlink_T *l1 = &e->link, *l2 = Histlist;
-    while ((l1 = l1->prev) != Histlist) {
-        l2 = l2->prev;
+    double minweight = m->nextweight;
+    for (size_t i = prediction_sample_head; i < prediction_sample_tail; i++)
+        for (size_t k = 0; k < PREDICTION_ORDER; k++)
+            if (prediction_samples[i].models[k] == m
+                    && prediction_samples[i].weights[k] < minweight)
+                minweight = prediction_samples[i].weights[k];
 
-        const histentry_T *e1 = (const histentry_T *) l1;
-        const histentry_T *e2 = (const histentry_T *) l2;
-        if (strcmp(e1->value, e2->value) != 0)
+    double factor = 1.0 / minweight;
+    for (size_t i = prediction_sample_head; i < prediction_sample_tail; i++)
+        for (size_t k = 0; k < PREDICTION_ORDER; k++)
+            if (prediction_samples[i].models[k] == m)
+                prediction_samples[i].weights[k] *= factor;
+    trie_scale_probability(m->tree, factor);
+    m->nextweight *= factor;
+}
+
+/* Sets `prediction_trees' and `prediction_weights' to the models whose context
+ * matches the newest history entries. Each model is normalized by its total
+ * probability. The models are built if not yet. */
+void select_prediction_models(void)
+{
+    if (!prediction_valid)
+        build_prediction_models();
+
+    prediction_count = 0;
+
+    xstrbuf_T context;
+    sb_init(&context);
+    const histlink_T *l = Histlist;
+    for (size_t k = 0; k < PREDICTION_ORDER; k++) {
+        if (k > 0) {
+            l = l->prev;
+            if (l == Histlist)
+                break;
+            if (k > 1)
+                sb_ccat(&context, '\n');
+            sb_cat(&context, ashistentry(l)->value);
+        }
+
+        const struct predmodel_T *m =
+            ht_get(&prediction_models, context.contents).value;
+        if (m == NULL)
             break;
-        count++;
-        if (count >= N - 1)
+        double total = trie_total_probability(m->tree);
+        if (total <= 0.0)
             break;
+        prediction_trees[prediction_count] = m->tree;
+        prediction_weights[prediction_count] = 1.0 / total;
+        prediction_count++;
     }
-    return count;
+    sb_destroy(&context);
 }
-#undef N
 
 /* Clears the second part of `le_main_buffer'.
  * Commands that modify the buffer usually need to call this function. However,
@@ -2571,8 +2981,8 @@ void update_buffer_with_prediction(void)
 
     le_main_length = le_main_buffer.length;
 
-    wchar_t *suffix = trie_probable_key(
-            prediction_tree, le_main_buffer.contents);
+    wchar_t *suffix = trie_probable_key_mixed(prediction_count,
+            prediction_trees, prediction_weights, le_main_buffer.contents);
     wb_catfree(&le_main_buffer, suffix);
 }
 
@@ -3497,7 +3907,8 @@ void go_to_history(const histlink_T *l, enum le_search_type_T curpos)
     wb_clear(&le_main_buffer);
     if (l == undo_history_entry && undo_index < undo_history.length) {
         struct undo_history *h = undo_history.contents[undo_index];
-        wb_cat(&le_main_buffer, h->contents);
+        wb_ncat_force(&le_main_buffer,
+                undo_snapshot.contents, undo_snapshot.length);
         assert(h->index <= le_main_buffer.length);
         le_main_index = h->index;
     } else {
@@ -3697,15 +4108,19 @@ void perform_search(const wchar_t *pattern,
 {
     const histlink_T *l = main_history_entry;
     xfnmatch_T *xfnm;
+    wchar_t *literal = NULL;
 
     if (dir == FORWARD && l == Histlist)
         goto done;
 
     switch (type) {
         case SEARCH_PREFIX: {
-            wchar_t *p = escape(pattern, NULL);
-            xfnm = xfnm_compile(p, XFNM_HEADONLY);
-            free(p);
+            wchar_t array[XWCSBUF_STACKSIZE];
+            xwcsbuf_T p;
+            wb_initwithstack(&p, array, XWCSBUF_STACKSIZE);
+            xfnm = xfnm_compile(
+                    wb_escape(&p, pattern, NULL)->contents, XFNM_HEADONLY);
+            wb_destroy(&p);
             break;
         }
         case SEARCH_VI: {
@@ -3719,32 +4134,51 @@ void perform_search(const wchar_t *pattern,
                 }
             }
             xfnm = xfnm_compile(pattern, flags);
+            literal = get_pattern_literal(pattern);
             break;
         }
         case SEARCH_EMACS: {
-            wchar_t *p = escape(pattern, NULL);
-            xfnm = xfnm_compile(p, 0);
-            free(p);
+            wchar_t array[XWCSBUF_STACKSIZE];
+            xwcsbuf_T p;
+            wb_initwithstack(&p, array, XWCSBUF_STACKSIZE);
+            xfnm = xfnm_compile(wb_escape(&p, pattern, NULL)->contents, 0);
+            wb_destroy(&p);
             break;
         }
         default:
             assert(false);
     }
     if (xfnm == NULL) {
+        free(literal);
         l = Histlist;
         goto done;
     }
 
+    /* Use the history index to skip entries that do not contain the literal
+     * part of the pattern. */
+    histsearch_T *search = NULL;
+    char *mbsliteral = malloc_wcstombs(literal != NULL ? literal : pattern);
+    free(literal);
+    if (mbsliteral != NULL) {
+        search = histsearch_compile(mbsliteral);
+        free(mbsliteral);
+    }
+
     for (;;) {
-        switch (dir) {
-            case FORWARD:   l = l->next;  break;
-            case BACKWARD:  l = l->prev;  break;
-        }
+        if (search != NULL)
+            l = histsearch_next(search, l, dir == FORWARD);
+        else
+            switch (dir) {
+                case FORWARD:   l = l->next;  break;
+                case BACKWARD:  l = l->prev;  break;
+            }
         if (l == Histlist)
             break;
         if (xfnm_match(xfnm, ashistentry(l)->value) == 0)
             break;
     }
+    if (search != NULL)
+        histsearch_free(search);
     xfnm_free(xfnm);
 done:
     le_search_result = l;
@@ -3863,8 +4297,7 @@ bool beginning_search_check_go_to_history(const wchar_t *prefix)
 {
     if (le_search_result == undo_history_entry
             && undo_index < undo_history.length) {
-        const struct undo_history *h = undo_history.contents[undo_index];
-        return matchwcsprefix(h->contents, prefix) != NULL;
+        return matchwcsprefix(undo_snapshot.contents, prefix) != NULL;
     } else {
         return false;
     }
@@ -42,6 +42,15 @@ extern wchar_t *le_editing_finalize(void)
     __attribute__((malloc,warn_unused_result));
 extern void le_invoke_command(le_command_func_T *cmd, wchar_t arg)
     __attribute__((nonnull));
+extern void le_insert_paste(const wchar_t *text)
+    __attribute__((nonnull));
+
+struct histentry_T;
+extern void le_predict_add_history(const struct histentry_T *e)
+    __attribute__((nonnull));
+extern void le_predict_remove_history(const struct histentry_T *e)
+    __attribute__((nonnull));
+extern void le_predict_reset_history(void);
 
 
 /********** Commands **********/
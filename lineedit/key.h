@@ -210,6 +210,7 @@
 #define Key_eof       L"\\#"    // EOF
 #define Key_kill      L"\\$"    // KILL
 #define Key_erase     L"\\?"    // ERASE
+#define Key_paste_begin L"\\%"  // start of bracketed paste (not bindable)
 #define Key_tab       Key_c_i
 #define Key_newline   Key_c_j
 #define Key_cr        Key_c_m
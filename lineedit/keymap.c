@@ -29,6 +29,7 @@
 #include "../builtin.h"
 #include "../exec.h"
 #include "../expand.h"
+#include "../strbuf.h"
 #include "../util.h"
 #include "../xfnmatch.h"
 #include "complete.h"
@@ -535,7 +536,8 @@ int print_binding_main(
 {
     const char *format;
     char modechar;
-    wchar_t *keyseqquote;
+    wchar_t array[XWCSBUF_STACKSIZE];
+    xwcsbuf_T keyseqquote;
     const char *commandname;
 
     switch (le_mode_to_id(mode)) {
@@ -551,10 +553,11 @@ int print_binding_main(
         format = "bindkey -%c -- %ls %s\n";
     else
         format = "bindkey -%c %ls %s\n";
-    keyseqquote = quote_as_word(keyseq);
+    wb_initwithstack(&keyseqquote, array, XWCSBUF_STACKSIZE);
+    wb_quote_as_word(&keyseqquote, keyseq);
     commandname = get_command_name(cmd);
-    xprintf(format, modechar, keyseqquote, commandname);
-    free(keyseqquote);
+    xprintf(format, modechar, keyseqquote.contents, commandname);
+    wb_destroy(&keyseqquote);
     return (yash_error_message_count == 0) ? Exit_SUCCESS : Exit_FAILURE;
 }
 
@@ -24,6 +24,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/select.h>
 #include <unistd.h>
 #include <wchar.h>
 #include "../option.h"
@@ -50,6 +51,8 @@ static inline bool has_meta_bit(char c)
 static inline trieget_T make_trieget(const wchar_t *keyseq)
     __attribute__((nonnull,const));
 static void append_to_second_buffer(wchar_t wc);
+static void read_paste(void);
+static void finish_paste(size_t length, size_t restindex);
 
 
 /* The state of line-editing. */
@@ -159,6 +162,10 @@ static mbstate_t reader_state;
 static xwcsbuf_T reader_second_buffer;
 /* If true, next input will be inserted directly to the main buffer. */
 bool le_next_verbatim;
+/* True while reading text in bracketed paste. */
+static bool reader_pasting;
+/* Buffer that contains bytes read in bracketed paste. */
+static xstrbuf_T reader_paste_buffer;
 
 /* Initializes the state of the reader. */
 void reader_init(bool trap)
@@ -168,6 +175,7 @@ void reader_init(bool trap)
     memset(&reader_state, 0, sizeof reader_state);
     wb_init(&reader_second_buffer);
     le_next_verbatim = false;
+    reader_pasting = false;
 }
 
 /* Frees memory used by the reader. */
@@ -175,6 +183,10 @@ void reader_finalize(void)
 {
     sb_destroy(&reader_first_buffer);
     wb_destroy(&reader_second_buffer);
+    if (reader_pasting) {
+        sb_destroy(&reader_paste_buffer);
+        reader_pasting = false;
+    }
 }
 
 /* Reads the next byte from the standard input and take all the corresponding
@@ -190,13 +202,22 @@ void read_next(void)
 
     assert(le_editstate == LE_EDITSTATE_EDITING);
 
+    if (reader_pasting) {
+        read_paste();
+        return;
+    }
+
     bool timeout = false;
     char c = pop_prebuffer();
     if (c != '\0')
         goto direct_first_buffer;
 
-    le_display_update(true);
-    le_display_flush();
+    /* While the next byte is already available, the display is not updated
+     * so that fast input is not slowed down by redrawing after every byte. */
+    if (!le_input_pending()) {
+        le_display_update(true);
+        le_display_flush();
+    }
 
     /* wait for and read the next byte */
     switch (wait_for_input(STDIN_FILENO, reader_trap,
@@ -271,6 +292,16 @@ direct_first_buffer:
             case TG_AMBIGUOUS:
                 if (timeout) {
             case TG_EXACTMATCH:
+                    if (wcscmp(tg.value.keyseq, Key_paste_begin) == 0) {
+                        /* start reading pasted text */
+                        sb_init(&reader_paste_buffer);
+                        sb_ncat_force(&reader_paste_buffer,
+                                &reader_first_buffer.contents[tg.matchlength],
+                                reader_first_buffer.length - tg.matchlength);
+                        sb_clear(&reader_first_buffer);
+                        reader_pasting = true;
+                        goto process_keymap;
+                    }
                     sb_remove(&reader_first_buffer, 0, tg.matchlength);
                     wb_cat(&reader_second_buffer, tg.value.keyseq);
                     continue;
@@ -351,6 +382,114 @@ process_keymap:
     }
 }
 
+/* Reads bytes in bracketed paste until the end of paste.
+ * Unlike the usual input, the bytes are read in bulk without key code
+ * processing or redrawing the display. When the end of paste is found, the
+ * pasted text is inserted into the main buffer at once and the bytes following
+ * the end of paste are pushed back to the prebuffer. */
+void read_paste(void)
+{
+    assert(le_paste_end != NULL);
+
+    size_t oldlength = reader_paste_buffer.length;
+    if (reader_prebuffer.contents != NULL) {
+        sb_ncat_force(&reader_paste_buffer,
+                reader_prebuffer.contents, reader_prebuffer.length);
+        sb_destroy(&reader_prebuffer);
+        reader_prebuffer.contents = NULL;
+    } else {
+        switch (wait_for_input(STDIN_FILENO, reader_trap, -1)) {
+            case W_READY:;
+                char buf[BUFSIZ];
+                ssize_t n = read(STDIN_FILENO, buf, sizeof buf);
+                if (n > 0) {
+                    sb_ncat_force(&reader_paste_buffer, buf, (size_t) n);
+                    break;
+                } else if (n < 0) {
+                    switch (errno) {
+                        case EAGAIN:
+#if EAGAIN != EWOULDBLOCK
+                        case EWOULDBLOCK:
+#endif
+                        case EINTR:
+                            return;
+                        default:
+                            xerror(errno, Ngt("cannot read input"));
+                            break;
+                    }
+                }
+                /* falls thru! */
+            case W_ERROR:
+                le_editstate = LE_EDITSTATE_ERROR;
+                return;
+            case W_TIMED_OUT:
+                return;
+            case W_INTERRUPTED:
+                le_editstate = LE_EDITSTATE_INTERRUPTED;
+                return;
+        }
+    }
+
+    /* search for the end of paste in the newly read bytes */
+    size_t endlength = strlen(le_paste_end);
+    size_t i = (oldlength >= endlength) ? oldlength - endlength + 1 : 0;
+    for (; i + endlength <= reader_paste_buffer.length; i++) {
+        if (memcmp(&reader_paste_buffer.contents[i],
+                    le_paste_end, endlength) == 0) {
+            finish_paste(i, i + endlength);
+            return;
+        }
+    }
+}
+
+/* Inserts the first `length' bytes of the paste buffer into the main buffer
+ * and pushes back the bytes after `restindex' to the prebuffer.
+ * Carriage returns are converted to newlines and bytes that cannot be
+ * converted to characters are ignored. */
+void finish_paste(size_t length, size_t restindex)
+{
+    if (restindex < reader_paste_buffer.length) {
+        xstrbuf_T rest;
+        sb_init(&rest);
+        sb_ncat_force(&rest, &reader_paste_buffer.contents[restindex],
+                reader_paste_buffer.length - restindex);
+        le_append_to_prebuffer(sb_tostr(&rest));
+    }
+
+    xwcsbuf_T text;
+    mbstate_t state;
+    wb_init(&text);
+    memset(&state, 0, sizeof state);
+    for (size_t i = 0; i < length; ) {
+        wchar_t wc;
+        size_t n = mbrtowc(&wc,
+                &reader_paste_buffer.contents[i], length - i, &state);
+        switch (n) {
+            case 0:
+                i++;
+                continue;
+            case (size_t) -1:
+            case (size_t) -2:
+                memset(&state, 0, sizeof state);
+                i++;
+                continue;
+        }
+        i += n;
+        if (wc == L'\r') {
+            if (i < length && reader_paste_buffer.contents[i] == '\n')
+                i++;
+            wc = L'\n';
+        }
+        wb_wccat(&text, wc);
+    }
+
+    sb_destroy(&reader_paste_buffer);
+    reader_pasting = false;
+
+    le_insert_paste(text.contents);
+    wb_destroy(&text);
+}
+
 /* Returns a timeout value to be passed to the `wait_for_input' function.
  * The value is taken from the $YASH_LE_TIMEOUT variable. */
 int get_read_timeout(void)
@@ -377,6 +516,18 @@ void le_append_to_prebuffer(char *s)
         sb_catfree(&reader_prebuffer, s);
 }
 
+/* Returns true if the standard input has bytes that can be read immediately.
+ * Input that has already been read into the reader's buffers is not counted. */
+bool le_input_pending(void)
+{
+    fd_set fdset;
+    struct timeval tv = { .tv_sec = 0, .tv_usec = 0, };
+    FD_ZERO(&fdset);
+    FD_SET(STDIN_FILENO, &fdset);
+    return select(STDIN_FILENO + 1, &fdset, NULL, NULL, &tv) > 0
+        && FD_ISSET(STDIN_FILENO, &fdset);
+}
+
 /* Removes and returns the next character in the prebuffer if available;
  * otherwise, returns '\0'. */
 char pop_prebuffer(void)
@@ -58,6 +58,10 @@
 
 
 /* terminfo capabilities */
+#define TI_BD      "BD"
+#define TI_BE      "BE"
+#define TI_PE      "PE"
+#define TI_PS      "PS"
 #define TI_am      "am"
 #define TI_bel     "bel"
 #define TI_blink   "blink"
@@ -74,10 +78,14 @@
 #define TI_cuf1    "cuf1"
 #define TI_cuu     "cuu"
 #define TI_cuu1    "cuu1"
+#define TI_dch     "dch"
+#define TI_dch1    "dch1"
 #define TI_dim     "dim"
 #define TI_ed      "ed"
 #define TI_el      "el"
 #define TI_flash   "flash"
+#define TI_ich     "ich"
+#define TI_ich1    "ich1"
 #define TI_invis   "invis"
 #define TI_kBEG    "kBEG"
 #define TI_kCAN    "kCAN"
@@ -262,6 +270,9 @@ int le_ti_xmc;
 /* Whether the terminal has the "xenl" and "msgr" flags set. */
 _Bool le_ti_xenl, le_ti_msgr;
 
+/* Whether the terminal has the "ich"/"ich1" and "dch"/"dch1" capabilities. */
+_Bool le_ti_ich, le_ti_dch;
+
 /* True if the meta key inputs character whose 8th bit is set. */
 /* Used only if the `shopt_le_convmeta' option is "auto". */
 _Bool le_meta_bit8;
@@ -270,12 +281,21 @@ _Bool le_meta_bit8;
  * The values of entries are `keyseq'. */
 trie_T *le_keycodes = NULL;
 
+/* The string the terminal sends at the end of bracketed paste, or NULL if
+ * bracketed paste is not supported. The start of bracketed paste is included
+ * in `le_keycodes' as `Key_paste_begin'. */
+const char *le_paste_end;
+
 /* True if the terminal is set to the keyboard-transmit mode. */
 static _Bool transmit_mode = 0;
+/* True if the terminal is set to the bracketed paste mode. */
+static _Bool paste_mode = 0;
 
 
 static inline int is_strcap_valid(const char *s)
     __attribute__((const));
+static inline int is_strcap_nonempty(const char *s)
+    __attribute__((pure));
 static void set_up_keycodes(void);
 static _Bool try_print_cap(const char *capname)
     __attribute__((nonnull));
@@ -289,6 +309,8 @@ static void print_color_code(long color, char *seta, char *set)
     __attribute__((nonnull));
 static void print_smkx(void);
 static void print_rmkx(void);
+static void print_be(void);
+static void print_bd(void);
 static int putchar_stderr(int c);
 
 
@@ -298,6 +320,12 @@ int is_strcap_valid(const char *s)
     return s != NULL && s != (const char *) -1;
 }
 
+/* Checks if the result of `tigetstr' is valid and not an empty string. */
+int is_strcap_nonempty(const char *s)
+{
+    return is_strcap_valid(s) && s[0] != '\0';
+}
+
 /* Calls `setupterm' and checks if terminfo data is available.
  * If `bypass' is true and `le_need_term_update' is false, the terminfo data
  * are not refreshed and only the terminal size (`le_lines' and `le_columns')
@@ -354,6 +382,10 @@ _Bool le_setupterm(_Bool bypass)
     le_ti_xenl = tigetflag(TI_xenl) > 0;
     le_ti_msgr = tigetflag(TI_msgr) > 0;
     le_meta_bit8 = tigetflag(TI_km) > 0;
+    le_ti_ich = is_strcap_nonempty(tigetstr(TI_ich))
+            || is_strcap_nonempty(tigetstr(TI_ich1));
+    le_ti_dch = is_strcap_nonempty(tigetstr(TI_dch))
+            || is_strcap_nonempty(tigetstr(TI_dch1));
 
     set_up_keycodes();
 
@@ -549,6 +581,19 @@ void set_up_keycodes(void)
             t = trie_set(t, seq, (trievalue_T) { .keyseq = keymap[i].keyseq });
     }
 
+    /* Bracketed paste is supported only if all the related (extended)
+     * capabilities are defined. */
+    const char *ps = tigetstr(TI_PS), *pe = tigetstr(TI_PE);
+    if (is_strcap_valid(ps) && ps[0] != '\0'
+            && is_strcap_valid(pe) && pe[0] != '\0'
+            && is_strcap_valid(tigetstr(TI_BE))
+            && is_strcap_valid(tigetstr(TI_BD))) {
+        t = trie_set(t, ps, (trievalue_T) { .keyseq = Key_paste_begin });
+        le_paste_end = pe;
+    } else {
+        le_paste_end = NULL;
+    }
+
     le_keycodes = t;
 }
 
@@ -592,8 +637,8 @@ void lebuf_print_nel(void)
 }
 
 /* Moves the cursor.
- * `capone' must be one of "cub1", "cuf1", "cud1", "cuu1".
- * `capmul' must be one of "cub", "cuf", "cud", "cuu". */
+ * `capone' must be one of "cub1", "cuf1", "cud1", "cuu1", "ich1", "dch1".
+ * `capmul' must be one of "cub", "cuf", "cud", "cuu", "ich", "dch". */
 void move_cursor(char *capone, char *capmul, long count, int affcnt)
 {
     if (count > 0) {
@@ -690,6 +735,26 @@ _Bool lebuf_print_ed(void)
     return try_print_cap(TI_ed);
 }
 
+/* Prints the "ich"/"ich1" code to the print buffer.
+ * (insert `count' blank characters at the cursor, shifting the rest of the
+ * line to the right)
+ * The cursor position is not changed. `le_ti_ich' must be true. */
+void lebuf_print_ich(long count)
+{
+    assert(le_ti_ich);
+    move_cursor(TI_ich1, TI_ich, count, 1);
+}
+
+/* Prints the "dch"/"dch1" code to the print buffer.
+ * (delete `count' characters at the cursor, shifting the rest of the line to
+ * the left)
+ * The cursor position is not changed. `le_ti_dch' must be true. */
+void lebuf_print_dch(long count)
+{
+    assert(le_ti_dch);
+    move_cursor(TI_dch1, TI_dch, count, 1);
+}
+
 /* Prints the "clear" code if available. (clear whole screen)
  * Returns true iff successful. */
 _Bool lebuf_print_clear(void)
@@ -847,6 +912,28 @@ void print_rmkx(void)
     }
 }
 
+/* Prints the "BE" code to the standard error and sets the `paste_mode' flag
+ * if bracketed paste is supported. */
+void print_be(void)
+{
+    if (le_paste_end != NULL) {
+        tputs(tigetstr(TI_BE), 1, putchar_stderr);
+        paste_mode = 1;
+    }
+}
+
+/* Prints the "BD" code to the standard error if the `paste_mode' flag is set.
+ * The flag is cleared in this function. */
+void print_bd(void)
+{
+    if (paste_mode) {
+        char *v = tigetstr(TI_BD);
+        if (is_strcap_valid(v))
+            tputs(v, 1, putchar_stderr);
+        paste_mode = 0;
+    }
+}
+
 /* Like `putchar', but prints to `stderr'. */
 int putchar_stderr(int c)
 {
@@ -908,6 +995,7 @@ _Bool le_set_terminal(void)
 
     // XXX it should be configurable whether we print smkx or not.
     print_smkx();
+    print_be();
 
     return 1;
 
@@ -942,6 +1030,7 @@ _Bool le_save_terminal(void)
 _Bool le_restore_terminal(void)
 {
     print_rmkx();
+    print_bd();
     fflush(stderr);
     return xtcsetattr(STDIN_FILENO, TCSADRAIN, &original_terminal_state) >= 0;
 }
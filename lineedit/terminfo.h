@@ -25,8 +25,10 @@ extern _Bool le_need_term_update;
 extern int le_lines, le_columns, le_colors;
 extern int le_ti_xmc;
 extern _Bool le_ti_am, le_ti_xenl, le_ti_msgr;
+extern _Bool le_ti_ich, le_ti_dch;
 extern _Bool le_meta_bit8;
 extern struct trienode_T /* trie_T */ *le_keycodes;
+extern const char *le_paste_end;
 
 extern _Bool le_setupterm(_Bool bypass);
 
@@ -49,6 +51,8 @@ extern void lebuf_print_cud(long count);
 extern void lebuf_print_cuu(long count);
 extern _Bool lebuf_print_el(void);
 extern _Bool lebuf_print_ed(void);
+extern void lebuf_print_ich(long count);
+extern void lebuf_print_dch(long count);
 extern _Bool lebuf_print_clear(void);
 extern _Bool lebuf_print_op(void);
 extern void lebuf_print_setfg(long color);
@@ -68,8 +68,9 @@ static int foreachw(const trienode_T *t,
         void *v,
         xwcsbuf_T *buf)
     __attribute__((nonnull(1,2,4)));
-static const trieentry_T *most_probable_child(const trienode_T *node)
-    __attribute__((nonnull,pure));
+static bool most_probable_child(size_t n, const trienode_T *const *nodes,
+        const double *weights, wchar_t *keyp, double *probabilityp)
+    __attribute__((nonnull));
 
 
 /* Creates a new empty trie. */
@@ -436,27 +437,91 @@ trienode_T *trie_add_probability(
     return node;
 }
 
+/* Subtracts the given probability value `p' from each node on the given key
+ * string `keywcs', which must have been added by `trie_add_probability'.
+ * Nodes whose probability falls below `epsilon' are removed. The root node is
+ * never removed. */
+trienode_T *trie_subtract_probability(
+        trienode_T *node, const wchar_t *keywcs, double p, double epsilon)
+{
+    assert(node->valuevalid);
+    node->value.probability -= p;
+
+    if (keywcs[0] == L'\0')
+        return node;
+
+    ssize_t index = searchw(node, keywcs[0]);
+    if (index < 0)
+        return node;
+
+    trienode_T *child = node->entries[index].child;
+    if (child->value.probability - p < epsilon) {
+        trie_destroy(child);
+        memmove(&node->entries[index], &node->entries[index + 1],
+                sizeof *node->entries * (node->count - index - 1));
+        node = shrink(node);
+    } else {
+        node->entries[index].child =
+            trie_subtract_probability(child, &keywcs[1], p, epsilon);
+    }
+    return node;
+}
+
+/* Multiplies the probability value of every node by `factor'. */
+void trie_scale_probability(trienode_T *node, double factor)
+{
+    if (node->valuevalid)
+        node->value.probability *= factor;
+    for (size_t i = 0; i < node->count; i++)
+        trie_scale_probability(node->entries[i].child, factor);
+}
+
+/* Returns the sum of the probability values added to the trie. */
+double trie_total_probability(const trienode_T *node)
+{
+    return node->valuevalid ? node->value.probability : 0.0;
+}
+
 /* Returns the most probable key as a newly-malloced wide string.
  * Only keys that start with `skipkey' are considered. The `skipkey' prefix is
  * not included in the result.
  * Returns an empty string if no keys start with `skipkey'. */
 wchar_t *trie_probable_key(const trienode_T *node, const wchar_t *skipkey)
 {
+    return trie_probable_key_mixed(1, &node, (const double[]) { 1.0 }, skipkey);
+}
+
+/* Like `trie_probable_key', but the probability of a key is the weighted sum of
+ * the probabilities in the `n' tries. The weight for `tries[i]' is
+ * `weights[i]'. */
+wchar_t *trie_probable_key_mixed(size_t n, const trienode_T *const *tries,
+        const double *weights, const wchar_t *skipkey)
+{
+    if (n == 0)
+        return xwcsdup(L"");
+
+    const trienode_T *nodes[n];
+
     // Skip the prefix to ignore.
-    while (*skipkey != L'\0') {
-        ssize_t index = searchw(node, *skipkey);
-        if (index < 0)
-            return xwcsdup(L"");
-        node = node->entries[index].child;
-        skipkey++;
+    for (size_t i = 0; i < n; i++) {
+        nodes[i] = tries[i];
+        for (const wchar_t *k = skipkey; *k != L'\0'; k++) {
+            ssize_t index = searchw(nodes[i], *k);
+            if (index < 0) {
+                nodes[i] = NULL;
+                break;
+            }
+            nodes[i] = nodes[i]->entries[index].child;
+        }
     }
 
     // Find the most probable initial.
-    const trieentry_T *entry = most_probable_child(node);
-    if (entry == NULL)
+    wchar_t c;
+    double probability;
+    if (!most_probable_child(n, nodes, weights, &c, &probability))
         return xwcsdup(L"");
 
-    double threshold = entry->child->value.probability / 2;
+    double threshold = probability / 2;
 
     // Traverse nodes that have the most probability to construct the final
     // result. Stop traversal when the probability falls below the threshold.
@@ -466,31 +531,58 @@ wchar_t *trie_probable_key(const trienode_T *node, const wchar_t *skipkey)
     xwcsbuf_T key;
     wb_init(&key);
 
-    while (entry != NULL &&
-            (entry->child->value.probability >= threshold ||
-             iswblank(entry->key.as_wchar))) {
-        wb_wccat(&key, entry->key.as_wchar);
-        entry = most_probable_child(entry->child);
-    }
+    do {
+        if (probability < threshold && !iswblank(c))
+            break;
+        wb_wccat(&key, c);
+        for (size_t i = 0; i < n; i++) {
+            if (nodes[i] == NULL)
+                continue;
+            ssize_t index = searchw(nodes[i], c);
+            nodes[i] = (index < 0) ? NULL : nodes[i]->entries[index].child;
+        }
+    } while (most_probable_child(n, nodes, weights, &c, &probability));
 
     return wb_towcs(&key);
 }
 
-/* Find the given node's child that have the most probability value.
- * Returns NULL iff the node has no children. */
-const trieentry_T *most_probable_child(const trienode_T *node)
+/* Finds the child that has the most probability value among the children of
+ * the given nodes, where the probability of a child is the weighted sum of the
+ * probabilities of the children of the same key. Nodes may be NULL.
+ * Returns false iff the nodes have no children. */
+bool most_probable_child(size_t n, const trienode_T *const *nodes,
+        const double *weights, wchar_t *keyp, double *probabilityp)
 {
     double max_probability = -HUGE_VAL;
-    const trieentry_T *entry = NULL;
-    for (size_t i = 0; i < node->count; i++) {
-        assert(node->entries[i].child->valuevalid);
-        double probability = node->entries[i].child->value.probability;
-        if (probability > max_probability) {
-            max_probability = probability;
-            entry = &node->entries[i];
+    bool found = false;
+    for (size_t i = 0; i < n; i++) {
+        if (nodes[i] == NULL)
+            continue;
+        for (size_t k = 0; k < nodes[i]->count; k++) {
+            wchar_t key = nodes[i]->entries[k].key.as_wchar;
+            double probability = 0.0;
+            for (size_t j = 0; j < n; j++) {
+                if (nodes[j] == NULL)
+                    continue;
+                ssize_t index = (j == i) ? (ssize_t) k : searchw(nodes[j], key);
+                if (index < 0)
+                    continue;
+                if (j < i)
+                    goto next; // already considered with nodes[j]
+                assert(nodes[j]->entries[index].child->valuevalid);
+                probability += weights[j]
+                    * nodes[j]->entries[index].child->value.probability;
+            }
+            if (probability > max_probability) {
+                max_probability = probability;
+                *keyp = key;
+                found = true;
+            }
+next:;
         }
     }
-    return entry;
+    *probabilityp = max_probability;
+    return found;
 }
 
 
@@ -65,8 +65,18 @@ extern void trie_destroy(trie_T *t);
 
 extern trie_T *trie_add_probability(trie_T *t, const wchar_t *keywcs, double p)
     __attribute__((nonnull,malloc,warn_unused_result));
+extern trie_T *trie_subtract_probability(
+        trie_T *t, const wchar_t *keywcs, double p, double epsilon)
+    __attribute__((nonnull,malloc,warn_unused_result));
+extern void trie_scale_probability(trie_T *t, double factor)
+    __attribute__((nonnull));
+extern double trie_total_probability(const trie_T *t)
+    __attribute__((nonnull,pure));
 extern wchar_t *trie_probable_key(const trie_T *t, const wchar_t *skipkey)
     __attribute__((nonnull,malloc,warn_unused_result));
+extern wchar_t *trie_probable_key_mixed(size_t n, const trie_T *const *tries,
+        const double *weights, const wchar_t *skipkey)
+    __attribute__((nonnull,malloc,warn_unused_result));
 
 
 #endif /* YASH_TRIE_H */
@@ -124,6 +124,9 @@ bool shopt_xtrace = false;
 bool shopt_traceall = true;
 
 #if YASH_ENABLE_HISTORY
+/* If set, the history file is written in the binary format.
+ * Corresponds to the --histbinary option. */
+bool shopt_histbinary = false;
 /* If set, lines that start with a space are not saved in the history.
  * Corresponds to the --histspace option. */
 bool shopt_histspace = false;
@@ -155,6 +158,9 @@ bool shopt_extendedglob = false;
  * intact when there are no matches for it.
  * Corresponds to the --nullglob option. */
 bool shopt_nullglob = false;
+/* If set, recursive filename expansion searches directories in parallel.
+ * Corresponds to the --parallelglob option. */
+bool shopt_parallelglob = false;
 
 /* If set, brace expansion is enabled.
  * Corresponds to the --braceexpand option. */
@@ -194,6 +200,9 @@ bool shopt_le_alwaysrp = false;
 bool shopt_le_predict = false;
 /* If set, auto-suggest also provides suggestions for empty input lines. */
 bool shopt_le_predictempty = false;
+/* If set, command completion is cancelled when the user types a key while
+ * candidates are being generated. */
+bool shopt_le_compcancel = false;
 /* If set, debugging information is printed during command completion. */
 bool shopt_le_compdebug = false;
 /* If set, the right prompt will trim the extra space left at end for cursor
@@ -232,12 +241,14 @@ static const struct option_T shell_options[] = {
     { 0,    L'f', L"glob",           &shopt_glob,           true, },
     { L'h', 0,    L"hashondef",      &shopt_hashondef,      true, },
 #if YASH_ENABLE_HISTORY
+    { 0,    0,    L"histbinary",     &shopt_histbinary,     true, },
     { 0,    0,    L"histspace",      &shopt_histspace,      true, },
 #endif
     { 0,    0,    L"ignoreeof",      &shopt_ignoreeof,      true, },
     { L'i', 0,    L"interactive",    &is_interactive,       false, },
 #if YASH_ENABLE_LINEEDIT
     { 0,    0,    L"lealwaysrp",     &shopt_le_alwaysrp,    true, },
+    { 0,    0,    L"lecompcancel",   &shopt_le_compcancel,  true, },
     { 0,    0,    L"lecompdebug",    &shopt_le_compdebug,   true, },
     { 0,    0,    L"leconvmeta",     &shopt_le_yesconvmeta, true, },
     { 0,    0,    L"lenoconvmeta",   &shopt_le_noconvmeta,  true, },
@@ -256,6 +267,7 @@ static const struct option_T shell_options[] = {
     { 0,    0,    L"notifyle",       &shopt_notifyle,       true, },
 #endif
     { 0,    0,    L"nullglob",       &shopt_nullglob,       true, },
+    { 0,    0,    L"parallelglob",   &shopt_parallelglob,   true, },
     { 0,    0,    L"pipefail",       &shopt_pipefail,       true, },
     { 0,    0,    L"posixlycorrect", &posixly_correct,      true, },
     { L's', 0,    L"stdin",          &shopt_stdin,          false, },
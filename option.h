@@ -46,10 +46,10 @@ extern _Bool shopt_errexit, shopt_errreturn, shopt_pipefail, shopt_unset,
        shopt_exec, shopt_ignoreeof, shopt_verbose, shopt_xtrace;
 extern _Bool shopt_traceall;
 #if YASH_ENABLE_HISTORY
-extern _Bool shopt_histspace;
+extern _Bool shopt_histbinary, shopt_histspace;
 #endif
 extern _Bool shopt_glob, shopt_caseglob, shopt_dotglob, shopt_markdirs,
-       shopt_extendedglob, shopt_nullglob;
+       shopt_extendedglob, shopt_nullglob, shopt_parallelglob;
 extern _Bool shopt_braceexpand;
 extern _Bool shopt_emptylastfield;
 extern _Bool shopt_clobber;
@@ -57,8 +57,8 @@ extern _Bool shopt_clobber;
 extern enum shopt_lineedit_T shopt_lineedit;
 extern enum shopt_yesnoauto_T shopt_le_convmeta;
 extern _Bool shopt_le_visiblebell, shopt_le_promptsp, shopt_le_alwaysrp,
-    shopt_le_predict, shopt_le_predictempty, shopt_le_compdebug,
-    shopt_le_trimright;
+    shopt_le_predict, shopt_le_predictempty, shopt_le_compcancel,
+    shopt_le_compdebug, shopt_le_trimright;
 #endif
 
 /* Whether or not this shell process is doing job control right now. */
@@ -2174,11 +2174,15 @@ assign_T *tryparse_assignment(parsestate_T *ps)
 
     const wchar_t *nameend = skip_name(ps->token->wu_string, is_name_char);
     size_t namelen = nameend - ps->token->wu_string;
+    bool append = !posixly_correct && nameend[0] == L'+' && nameend[1] == L'=';
+    if (append)
+        nameend++;
     if (namelen == 0 || *nameend != L'=')
         return NULL;
 
     assign_T *result = xmalloc(sizeof *result);
     result->next = NULL;
+    result->a_append = append;
     result->a_name = xwcsndup(ps->token->wu_string, namelen);
 
     /* remove the name and '=' from the token */
@@ -3812,6 +3816,8 @@ void print_assignments(
 {
     while (a != NULL) {
         wb_cat(&pr->buffer, a->a_name);
+        if (a->a_append)
+            wb_wccat(&pr->buffer, L'+');
         wb_wccat(&pr->buffer, L'=');
         switch (a->a_type) {
             case A_SCALAR:
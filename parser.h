@@ -269,6 +269,7 @@ typedef enum {
 typedef struct assign_T {
     struct assign_T *next;
     assigntype_T a_type;
+    _Bool a_append;
     wchar_t *a_name;
     union {
         struct wordunit_T *scalar;
@@ -278,7 +279,9 @@ typedef struct assign_T {
 #define a_scalar a_value.scalar
 #define a_array  a_value.array
 /* `a_scalar' may be NULL to denote an empty string.
- * `a_array' is an array of pointers to `wordunit_T'. */
+ * `a_array' is an array of pointers to `wordunit_T'.
+ * `a_append' is true for an assignment of the form `name+=value', which appends
+ * the value to the existing value of the variable. */
 
 /* type of redirection */
 typedef enum {
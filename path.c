@@ -31,11 +31,18 @@
 #if HAVE_PATHS_H
 # include <paths.h>
 #endif
+#if HAVE_PTHREAD
+#include <pthread.h>
+#endif
 #include <pwd.h>
+#if HAVE_PTHREAD
+#include <signal.h>
+#endif
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
@@ -353,59 +360,174 @@ int create_temporary_file(
 
 /********** Command Hashtable **********/
 
+/* The minimum interval in milliseconds between two checks of the same
+ * directory for modification. */
+#define CMDDIR_CHECK_INTERVAL 100
+
+/* The type of objects used to remember the status of directories that contain
+ * commands in the command hashtable. */
+typedef struct cmddir_T {
+    unsigned long cd_generation; /* incremented when modification is found */
+    bool cd_stable;              /* see below */
+    struct timespec cd_checktime;/* time of last check */
+    dev_t cd_dev;
+    ino_t cd_ino;
+    time_t cd_mtime, cd_ctime;
+    long cd_mtimensec;
+    hashtable_T *cd_names;       /* names of files in the directory or NULL */
+    unsigned long cd_namesgeneration; /* `cd_generation' for `cd_names' */
+    char cd_name[];              /* directory name, ending with a slash */
+} cmddir_T;
+/* `cd_stable' is true iff the directory could be examined by `stat' and its
+ * modification time was old enough to be sure that a later modification will
+ * change the time. Commands in a directory that is not stable are always
+ * verified by `stat'.
+ * `cd_names' is a set of the names of the files in the directory, which is
+ * made by `which_loadpath'. The set is valid while the directory is stable and
+ * `cd_generation' equals `cd_namesgeneration'. */
+
+/* The type of values in the command hashtable. */
+typedef struct cmdpath_T {
+    cmddir_T *cp_dir;            /* directory containing the command or NULL */
+    unsigned long cp_generation; /* `cd_generation' when last verified */
+    bool cp_verified;            /* whether `cp_generation' is valid */
+    char cp_path[];              /* full path of the command */
+} cmdpath_T;
+
 static inline void forget_command_path(const char *command)
     __attribute__((nonnull));
+static cmddir_T *get_cmddir(const char *path, size_t dirlen)
+    __attribute__((nonnull));
+static void free_cmddir(kvpair_T kv);
+static bool list_cmddir(cmddir_T *dir)
+    __attribute__((nonnull));
+static bool is_cmddir_stable(cmddir_T *dir)
+    __attribute__((nonnull));
+static bool is_recently_checked(struct timespec *last)
+    __attribute__((nonnull));
+static long stat_mtimensec(const struct stat *st)
+    __attribute__((nonnull,pure));
+static const char *lookup_cmdindex(const char *name, bool *available)
+    __attribute__((nonnull));
 static wchar_t *get_default_path(void)
     __attribute__((malloc,warn_unused_result));
 
 /* A hashtable from command names to their full path.
  * Keys are pointers to a multibyte string containing a command name and
- * values are pointers to a multibyte string containing the commands' full path.
- * For each entry, the key string is part of the value, that is, the last
- * pathname component of the value.
+ * values are pointers to `cmdpath_T' objects containing the commands' full
+ * path. For each entry, the key string is part of the `cp_path' member, that
+ * is, the last pathname component of the path.
  * Full paths may be relative, in which case the paths are unreliable because
  * the working directory may have been changed since the paths had been
  * entered. */
 static hashtable_T cmdhash;
+/* A hashtable that contains `cmddir_T' objects for the directories referred to
+ * by the entries of `cmdhash'. The keys are pointers to the `cd_name' member of
+ * the `cmddir_T' objects. */
+static hashtable_T cmddirhash;
 
 /* Initializes the command hashtable. */
 void init_cmdhash(void)
 {
     assert(cmdhash.capacity == 0);
     ht_init(&cmdhash, hashstr, htstrcmp);
+    ht_init(&cmddirhash, hashstr, htstrcmp);
 }
 
 /* Empties the command hashtable. */
 void clear_cmdhash(void)
 {
     ht_clear(&cmdhash, vfree);
+    ht_clear(&cmddirhash, free_cmddir);
+    clear_cmdindex();
 }
 
 /* Searches PATH for the specified command and returns its full pathname.
  * If `forcelookup' is false and the command is already entered in the command
  * hashtable, the value in the hashtable is returned. Otherwise, `which' is
  * called to search for the command, the result is entered into the hashtable,
- * and then it is returned. If no command is found, NULL is returned. */
+ * and then it is returned. If no command is found, NULL is returned.
+ * A remembered path is returned without checking the file if the directory
+ * containing it has not been modified since the path was last verified. */
 const char *get_command_path(const char *name, bool forcelookup)
 {
-    const char *path;
+    cmdpath_T *cp;
 
     if (!forcelookup) {
-        path = ht_get(&cmdhash, name).value;
-        if (path != NULL && path[0] == '/' && is_executable_regular(path))
-            return path;
+        cp = ht_get(&cmdhash, name).value;
+        if (cp != NULL && cp->cp_path[0] == '/') {
+            assert(cp->cp_dir != NULL);
+            if (is_cmddir_stable(cp->cp_dir)) {
+                if (cp->cp_verified
+                        && cp->cp_generation == cp->cp_dir->cd_generation)
+                    return cp->cp_path;
+                if (is_executable_regular(cp->cp_path)) {
+                    cp->cp_generation = cp->cp_dir->cd_generation;
+                    cp->cp_verified = true;
+                    return cp->cp_path;
+                }
+            } else {
+                if (is_executable_regular(cp->cp_path))
+                    return cp->cp_path;
+            }
+        }
     }
 
-    path = which(name, get_path_array(PA_PATH), is_executable_regular);
+    char *path = NULL;
+    bool indexed = false;
+    if (!forcelookup) {
+        const char *dir = lookup_cmdindex(name, &indexed);
+        if (dir != NULL)
+            path = which(name, (char *[]) { (char *) dir, NULL },
+                    is_executable_regular);
+        if (path == NULL && dir != NULL)
+            indexed = false;
+    }
+    if (!indexed)
+        path = which(name, get_path_array(PA_PATH), is_executable_regular);
     if (path != NULL) {
         size_t namelen = strlen(name), pathlen = strlen(path);
-        const char *nameinpath = path + pathlen - namelen;
+        cp = xmallocs(sizeof *cp, add(pathlen, 1), sizeof *cp->cp_path);
+        memcpy(cp->cp_path, path, pathlen + 1);
+        free(path);
+        cp->cp_dir = (cp->cp_path[0] == '/')
+                ? get_cmddir(cp->cp_path, pathlen - namelen) : NULL;
+        cp->cp_verified = false;
+
+        const char *nameinpath = cp->cp_path + pathlen - namelen;
         assert(strcmp(name, nameinpath) == 0);
-        vfree(ht_set(&cmdhash, nameinpath, path));
+        vfree(ht_set(&cmdhash, nameinpath, cp));
+        return cp->cp_path;
     } else {
         forget_command_path(name);
+        return NULL;
     }
-    return path;
+}
+
+/* Handles failure in executing a command whose path was returned from
+ * `get_command_path'. Since a remembered path may be returned without checking
+ * the file, it may have been removed or made non-executable in the meantime.
+ * If `path' is the very string remembered in the command hashtable, the
+ * command is searched for again and the new path is returned. Otherwise, or if
+ * the search yields the same path, NULL is returned. */
+const char *refresh_command_path(const char *path)
+{
+    const char *name = strrchr(path, '/');
+    if (name == NULL)
+        return NULL;
+    name++;
+
+    cmdpath_T *cp = ht_get(&cmdhash, name).value;
+    if (cp == NULL || cp->cp_path != path)
+        return NULL;
+
+    size_t pathlen = strlen(path);
+    char oldpath[pathlen + 1];
+    memcpy(oldpath, path, pathlen + 1);
+    const char *newpath = get_command_path(&oldpath[name - path], true);
+    if (newpath == NULL || strcmp(newpath, oldpath) == 0)
+        return NULL;
+    return newpath;
 }
 
 /* Removes the specified command from the command hashtable. */
@@ -414,6 +536,191 @@ void forget_command_path(const char *command)
     vfree(ht_remove(&cmdhash, command));
 }
 
+/* Returns the `cmddir_T' object for the directory whose name is the first
+ * `dirlen' bytes of `path'. The object is created if not yet existing. */
+cmddir_T *get_cmddir(const char *path, size_t dirlen)
+{
+    char name[dirlen + 1];
+    memcpy(name, path, dirlen);
+    name[dirlen] = '\0';
+
+    cmddir_T *dir = ht_get(&cmddirhash, name).value;
+    if (dir == NULL) {
+        dir = xmallocs(sizeof *dir, add(dirlen, 1), sizeof *dir->cd_name);
+        memcpy(dir->cd_name, name, dirlen + 1);
+        dir->cd_generation = 0;
+        dir->cd_stable = false;
+        dir->cd_checktime.tv_sec = -1;
+        dir->cd_checktime.tv_nsec = 0;
+        dir->cd_dev = 0;
+        dir->cd_ino = 0;
+        dir->cd_mtime = dir->cd_ctime = 0;
+        dir->cd_mtimensec = 0;
+        dir->cd_names = NULL;
+        dir->cd_namesgeneration = 0;
+        ht_set(&cmddirhash, dir->cd_name, dir);
+    }
+    return dir;
+}
+
+/* Frees the `cmddir_T' object that is the value of the specified pair. */
+void free_cmddir(kvpair_T kv)
+{
+    cmddir_T *dir = kv.value;
+    if (dir->cd_names != NULL) {
+        ht_clear(dir->cd_names, kfree);
+        ht_destroy(dir->cd_names);
+        free(dir->cd_names);
+    }
+    free(dir);
+}
+
+/* Reads the names of the files in the specified directory into
+ * `dir->cd_names'. Returns false if the directory cannot be read. */
+bool list_cmddir(cmddir_T *dir)
+{
+    DIR *d = opendir(dir->cd_name);
+    if (d == NULL)
+        return false;
+
+    if (dir->cd_names == NULL)
+        dir->cd_names = ht_init(xmalloc(sizeof *dir->cd_names),
+                hashstr, htstrcmp);
+    else
+        ht_clear(dir->cd_names, kfree);
+
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL)
+        kfree(ht_set(dir->cd_names, xstrdup(de->d_name), NULL));
+    closedir(d);
+
+    dir->cd_namesgeneration = dir->cd_generation;
+    return true;
+}
+
+/* Searches $YASH_LOADPATH for a readable regular file like `which'.
+ * Directories that the file name may be in are listed once and the list is
+ * reused while the directories are not modified, so that a file that is not in
+ * a directory is skipped without examining the directory each time.
+ * As directories are not re-examined within CMDDIR_CHECK_INTERVAL
+ * milliseconds, a file that has just been created may not be found. This
+ * function is hence intended for autoloading during command line completion.
+ * The result is a newly malloced string or NULL if no file is found. */
+char *which_loadpath(const char *name)
+{
+    char *const *dirs = get_path_array(PA_LOADPATH);
+    if (name[0] == '\0' || name[0] == '/' || dirs == NULL
+            || cmddirhash.capacity == 0)
+        return which(name, dirs, is_readable_regular);
+
+    const char *base = strrchr(name, '/');
+    size_t sublen = (base == NULL) ? 0 : (size_t) (base - name + 1);
+    base = &name[sublen];
+
+    for (const char *dir; (dir = *dirs) != NULL; dirs++) {
+        if (dir[0] == '/') {
+            xstrbuf_T dirpath;
+            sb_init(&dirpath);
+            sb_cat(&dirpath, dir);
+            if (dirpath.contents[dirpath.length - 1] != '/')
+                sb_ccat(&dirpath, '/');
+            sb_ncat_force(&dirpath, name, sublen);
+
+            cmddir_T *cd = get_cmddir(dirpath.contents, dirpath.length);
+            sb_destroy(&dirpath);
+            if (is_cmddir_stable(cd)
+                    && ((cd->cd_names != NULL
+                            && cd->cd_namesgeneration == cd->cd_generation)
+                        || list_cmddir(cd))
+                    && ht_get(cd->cd_names, base).key == NULL)
+                continue;
+        }
+
+        char *path = which(name, (char *[]) { (char *) dir, NULL },
+                is_readable_regular);
+        if (path != NULL)
+            return path;
+    }
+    return NULL;
+}
+
+/* Examines the specified directory for modification and returns the updated
+ * `cd_stable' flag. If the last examination was done within
+ * CMDDIR_CHECK_INTERVAL milliseconds, the directory is not examined again.
+ * When a modification is found, `dir->cd_generation' is incremented. */
+bool is_cmddir_stable(cmddir_T *dir)
+{
+    if (is_recently_checked(&dir->cd_checktime))
+        return dir->cd_stable;
+
+    struct stat st;
+    if (stat(dir->cd_name, &st) < 0) {
+        dir->cd_generation++;
+        dir->cd_stable = false;
+        return false;
+    }
+
+    if (st.st_dev != dir->cd_dev || st.st_ino != dir->cd_ino
+            || st.st_mtime != dir->cd_mtime || st.st_ctime != dir->cd_ctime
+            || stat_mtimensec(&st) != dir->cd_mtimensec) {
+        dir->cd_generation++;
+        dir->cd_dev = st.st_dev;
+        dir->cd_ino = st.st_ino;
+        dir->cd_mtime = st.st_mtime;
+        dir->cd_ctime = st.st_ctime;
+        dir->cd_mtimensec = stat_mtimensec(&st);
+    }
+
+    /* If the directory was modified within the last second, another
+     * modification in the same second might not change the time stamps. */
+    time_t wallnow = time(NULL);
+    dir->cd_stable = wallnow != (time_t) -1
+        && dir->cd_mtime < wallnow - 1 && dir->cd_ctime < wallnow - 1;
+    return dir->cd_stable;
+}
+
+/* Tests if CMDDIR_CHECK_INTERVAL milliseconds have not yet elapsed since the
+ * time `*last' (CLOCK_MONOTONIC). If they have, `*last' is updated to the
+ * current time and false is returned. A negative `last->tv_sec' means the
+ * check has never been done. If the current time is unknown, false is always
+ * returned. */
+bool is_recently_checked(struct timespec *last)
+{
+#if defined _POSIX_MONOTONIC_CLOCK && _POSIX_MONOTONIC_CLOCK >= 0
+    struct timespec now;
+    if (clock_gettime(CLOCK_MONOTONIC, &now) < 0)
+        return false;
+    if (last->tv_sec >= 0) {
+        long elapsed = (long) (now.tv_sec - last->tv_sec) * 1000
+            + (now.tv_nsec - last->tv_nsec) / 1000000;
+        if (0 <= elapsed && elapsed < CMDDIR_CHECK_INTERVAL)
+            return true;
+    }
+    *last = now;
+#else
+    (void) last;
+#endif
+    return false;
+}
+
+/* Returns the nanoseconds part of the modification time of the file or zero if
+ * unknown. */
+long stat_mtimensec(const struct stat *st)
+{
+#if HAVE_ST_MTIM
+    return st->st_mtim.tv_nsec;
+#elif HAVE_ST_MTIMESPEC
+    return st->st_mtimespec.tv_nsec;
+#elif HAVE_ST_MTIMENSEC
+    return (long) st->st_mtimensec;
+#elif HAVE___ST_MTIMENSEC
+    return (long) st->__st_mtimensec;
+#else
+    (void) st;
+    return 0;
+#endif
+}
+
 /* Last result of `get_command_path_default'. */
 static char *gcpd_value = NULL;
 /* Paths for `get_command_path_default'. */
@@ -466,6 +773,487 @@ wchar_t *get_default_path(void)
 }
 
 
+/********** Persistent Command Index **********/
+
+/* The command index is a file that lists the names of the commands found in
+ * the directories of $PATH. It is shared among shell processes so that a new
+ * shell can find commands without searching the directories one by one.
+ * The file is used only when the $YASH_PATH_INDEX variable names it and all
+ * the directories in $PATH are absolute.
+ *
+ * The file is written in the native byte order and consists of:
+ *  - a `cmdindex_header_T',
+ *  - `ch_dircount' `cmdindex_dir_T's, one for each directory in $PATH, in
+ *    order,
+ *  - `ch_namecount' `cmdindex_name_T's sorted by the command name, and
+ *  - null-terminated strings referred to by the `*_nameoff' members, which are
+ *    offsets from the beginning of the file.
+ * The file ends with a null byte. For each command name, the first directory
+ * containing an executable regular file of the name is recorded, so the index
+ * gives the same result as `which'. The index is valid as long as none of the
+ * directories is modified. */
+
+#define CMDINDEX_MAGIC "yashci1"
+
+/* The maximum number of names tried for the temporary file made in saving the
+ * command index. */
+#define MAX_CMDINDEX_TEMP_TRIES 100
+
+typedef struct cmdindex_header_T {
+    char ch_magic[8];
+    uint32_t ch_byteorder;   /* 0x01020304 */
+    uint32_t ch_euid, ch_egid;
+    uint32_t ch_dircount, ch_namecount;
+    uint32_t ch_size;        /* size of the whole file */
+} cmdindex_header_T;
+typedef struct cmdindex_dir_T {
+    uint64_t cd_dev, cd_ino;
+    int64_t cd_mtime, cd_ctime, cd_mtimensec;
+    uint64_t cd_nameoff;
+} cmdindex_dir_T;
+/* If the directory does not exist, all the members but `cd_nameoff' are zero.*/
+typedef struct cmdindex_name_T {
+    uint32_t cn_nameoff, cn_dir;
+} cmdindex_name_T;
+
+/* The current command index. */
+static struct {
+    enum { CI_UNKNOWN, CI_READY, CI_UNAVAILABLE, } state;
+    const char *contents;    /* the file contents if CI_READY */
+    size_t size;             /* the size of `contents' */
+    bool mapped;             /* whether `contents' is `mmap'ed or `malloc'ed */
+    struct timespec checktime;
+    time_t retrytime;        /* when to retry building if CI_UNAVAILABLE;
+                                (time_t) -1 means never until cleared */
+} cmdindex = { .state = CI_UNKNOWN, };
+
+static const cmdindex_header_T *get_cmdindex(void);
+static bool load_cmdindex(char *const *dirs)
+    __attribute__((nonnull));
+static bool build_cmdindex(char *const *dirs)
+    __attribute__((nonnull));
+static void save_cmdindex(void);
+static bool cmdindex_dirs_match(const cmdindex_header_T *h, char *const *dirs)
+    __attribute__((nonnull,pure));
+static bool cmdindex_dir_stamp(const char *dir, cmdindex_dir_T *cd)
+    __attribute__((nonnull));
+static void free_cmdindex(void);
+static int cmdindex_key_cmp(const void *kv1, const void *kv2)
+    __attribute__((nonnull,pure));
+static const char *lookup_cmdindex_rec(
+        const char *name, bool *available, bool recheck)
+    __attribute__((nonnull));
+static int cmdindex_name_cmp(const void *p1, const void *p2)
+    __attribute__((nonnull,pure));
+
+/* Discards the current command index so that it is reloaded when needed. */
+void clear_cmdindex(void)
+{
+    free_cmdindex();
+    cmdindex.state = CI_UNKNOWN;
+}
+
+/* Frees the contents of the command index. */
+void free_cmdindex(void)
+{
+    if (cmdindex.state == CI_READY) {
+        if (cmdindex.mapped)
+            munmap((void *) cmdindex.contents, cmdindex.size);
+        else
+            free((void *) cmdindex.contents);
+        cmdindex.contents = NULL;
+    }
+}
+
+/* Returns the command index for the current $PATH.
+ * The index is loaded from the file or built if necessary.
+ * Returns NULL if the index is not available. */
+const cmdindex_header_T *get_cmdindex(void)
+{
+    char *const *dirs = get_path_array(PA_PATH);
+    if (dirs == NULL)
+        return NULL;
+
+    switch (cmdindex.state) {
+        case CI_READY:;
+            const cmdindex_header_T *h = (const void *) cmdindex.contents;
+            if (!cmdindex_dirs_match(h, dirs))
+                break;
+            if (is_recently_checked(&cmdindex.checktime))
+                return h;
+
+            /* check if any directory has been modified */
+            const cmdindex_dir_T *cds = (const void *) &h[1];
+            for (uint32_t i = 0; i < h->ch_dircount; i++) {
+                cmdindex_dir_T cd;
+                cmdindex_dir_stamp(dirs[i], &cd);
+                if (cd.cd_dev != cds[i].cd_dev || cd.cd_ino != cds[i].cd_ino
+                        || cd.cd_mtime != cds[i].cd_mtime
+                        || cd.cd_ctime != cds[i].cd_ctime
+                        || cd.cd_mtimensec != cds[i].cd_mtimensec)
+                    goto rebuild;
+            }
+            return h;
+        case CI_UNAVAILABLE:
+            if (cmdindex.retrytime == (time_t) -1
+                    || time(NULL) < cmdindex.retrytime)
+                return NULL;
+            break;
+        case CI_UNKNOWN:
+            break;
+    }
+
+    free_cmdindex();
+    if (load_cmdindex(dirs))
+        goto ready;
+rebuild:
+    free_cmdindex();
+    if (build_cmdindex(dirs)) {
+        save_cmdindex();
+        goto ready;
+    }
+    return NULL;
+
+ready:
+    cmdindex.state = CI_READY;
+    cmdindex.checktime.tv_sec = -1;
+    is_recently_checked(&cmdindex.checktime);
+    return (const void *) cmdindex.contents;
+}
+
+/* Tests if the directories recorded in the index are the same as `dirs'. */
+bool cmdindex_dirs_match(const cmdindex_header_T *h, char *const *dirs)
+{
+    const cmdindex_dir_T *cds = (const void *) &h[1];
+    for (uint32_t i = 0; i < h->ch_dircount; i++, dirs++)
+        if (*dirs == NULL
+                || strcmp(*dirs, &cmdindex.contents[cds[i].cd_nameoff]) != 0)
+            return false;
+    return *dirs == NULL;
+}
+
+/* Gets the current time stamp of the specified directory.
+ * Returns true iff the directory is stable in the sense of `cd_stable' of
+ * `cmddir_T'. */
+bool cmdindex_dir_stamp(const char *dir, cmdindex_dir_T *cd)
+{
+    struct stat st;
+    if (stat(dir, &st) < 0) {
+        cd->cd_dev = cd->cd_ino = 0;
+        cd->cd_mtime = cd->cd_ctime = cd->cd_mtimensec = 0;
+        return true;
+    }
+    cd->cd_dev = (uint64_t) st.st_dev;
+    cd->cd_ino = (uint64_t) st.st_ino;
+    cd->cd_mtime = (int64_t) st.st_mtime;
+    cd->cd_ctime = (int64_t) st.st_ctime;
+    cd->cd_mtimensec = stat_mtimensec(&st);
+
+    time_t now = time(NULL);
+    return now != (time_t) -1 && st.st_mtime < now - 1 && st.st_ctime < now - 1;
+}
+
+/* Loads the command index from the file named by $YASH_PATH_INDEX.
+ * Returns true iff the file was successfully loaded and its contents are valid
+ * for the current $PATH (`dirs'). */
+bool load_cmdindex(char *const *dirs)
+{
+    const wchar_t *wfilename = getvar(L VAR_YASH_PATH_INDEX);
+    if (wfilename == NULL || wfilename[0] == L'\0')
+        return false;
+    char *filename = malloc_wcstombs(wfilename);
+    if (filename == NULL)
+        return false;
+    int fd = open(filename, O_RDONLY);
+    free(filename);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) >= 0 && st.st_size >= (off_t) sizeof (cmdindex_header_T)
+            && st.st_size <= (off_t) UINT32_MAX)
+        map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    xclose(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    cmdindex.contents = map;
+    cmdindex.size = (size_t) st.st_size;
+    cmdindex.mapped = true;
+    cmdindex.state = CI_READY;
+
+    /* validate the contents */
+    const cmdindex_header_T *h = map;
+    if (memcmp(h->ch_magic, CMDINDEX_MAGIC, sizeof h->ch_magic) != 0
+            || h->ch_byteorder != 0x01020304
+            || h->ch_euid != (uint32_t) geteuid()
+            || h->ch_egid != (uint32_t) getegid()
+            || h->ch_size != cmdindex.size
+            || cmdindex.contents[cmdindex.size - 1] != '\0')
+        return false;
+    size_t tablesize = sizeof *h
+        + (size_t) h->ch_dircount * sizeof (cmdindex_dir_T)
+        + (size_t) h->ch_namecount * sizeof (cmdindex_name_T);
+    if (h->ch_dircount > cmdindex.size || h->ch_namecount > cmdindex.size
+            || tablesize > cmdindex.size)
+        return false;
+    const cmdindex_dir_T *cds = (const void *) &h[1];
+    for (uint32_t i = 0; i < h->ch_dircount; i++)
+        if (cds[i].cd_nameoff < tablesize || cds[i].cd_nameoff >= cmdindex.size)
+            return false;
+    const cmdindex_name_T *cns = (const void *) &cds[h->ch_dircount];
+    for (uint32_t i = 0; i < h->ch_namecount; i++)
+        if (cns[i].cn_nameoff < tablesize || cns[i].cn_nameoff >= cmdindex.size
+                || cns[i].cn_dir >= h->ch_dircount)
+            return false;
+    if (!cmdindex_dirs_match(h, dirs))
+        return false;
+
+    /* check if any directory has been modified */
+    for (uint32_t i = 0; i < h->ch_dircount; i++) {
+        cmdindex_dir_T cd;
+        cmdindex_dir_stamp(dirs[i], &cd);
+        if (cd.cd_dev != cds[i].cd_dev || cd.cd_ino != cds[i].cd_ino
+                || cd.cd_mtime != cds[i].cd_mtime
+                || cd.cd_ctime != cds[i].cd_ctime
+                || cd.cd_mtimensec != cds[i].cd_mtimensec)
+            return false;
+    }
+    return true;
+}
+
+/* Builds a new command index by scanning the directories `dirs'.
+ * Returns true iff successful. If $YASH_PATH_INDEX is not set, any directory is
+ * relative, or any directory is not stable, the index is not built and it is
+ * marked unavailable. */
+bool build_cmdindex(char *const *dirs)
+{
+    cmdindex.state = CI_UNAVAILABLE;
+    cmdindex.retrytime = (time_t) -1;  /* never, until `clear_cmdindex' */
+
+    const wchar_t *filename = getvar(L VAR_YASH_PATH_INDEX);
+    if (filename == NULL || filename[0] == L'\0')
+        return false;
+
+    size_t dircount = plcount((void **) dirs);
+    for (size_t i = 0; i < dircount; i++)
+        if (dirs[i][0] != '/')
+            return false;
+    if (dircount > UINT32_MAX)
+        return false;
+
+    cmdindex_dir_T cds[dircount];
+    hashtable_T names;  /* from command names to directory indices */
+    xstrbuf_T pool, path;
+    ht_init(&names, hashstr, htstrcmp);
+    sb_init(&pool);
+    sb_init(&path);
+    sb_ccat(&pool, '\0');
+
+    bool stable = true;
+    for (size_t i = 0; i < dircount; i++) {
+        if (!cmdindex_dir_stamp(dirs[i], &cds[i]))
+            stable = false;
+        cds[i].cd_nameoff = pool.length;
+        sb_ncat_force(&pool, dirs[i], strlen(dirs[i]) + 1);
+
+        DIR *dir = opendir(dirs[i]);
+        if (dir == NULL)
+            continue;
+        sb_cat(sb_clear(&path), dirs[i]);
+        if (path.contents[path.length - 1] != '/')
+            sb_ccat(&path, '/');
+        size_t dirlen = path.length;
+        struct dirent *de;
+        while ((de = readdir(dir)) != NULL) {
+            if (ht_get(&names, de->d_name).key != NULL)
+                continue;
+            sb_cat(sb_truncate(&path, dirlen), de->d_name);
+            if (is_executable_regular(path.contents))
+                ht_set(&names, xstrdup(de->d_name), (void *) (uintptr_t) i);
+        }
+        closedir(dir);
+    }
+    sb_destroy(&path);
+
+    if (!stable) {
+        /* Some directory may be modified again without changing the time
+         * stamps. Try again later. */
+        cmdindex.retrytime = time(NULL) + 2;
+        ht_clear(&names, kfree);
+        ht_destroy(&names);
+        sb_destroy(&pool);
+        return false;
+    }
+
+    /* sort the names */
+    size_t namecount = names.count;
+    kvpair_T *kvs = ht_tokvarray(&names);
+    qsort(kvs, namecount, sizeof *kvs, cmdindex_key_cmp);
+
+    size_t tablesize = sizeof (cmdindex_header_T)
+        + dircount * sizeof (cmdindex_dir_T)
+        + namecount * sizeof (cmdindex_name_T);
+    cmdindex_name_T *cns = xmalloce(namecount, 1, sizeof *cns);
+    for (size_t i = 0; i < namecount; i++) {
+        cns[i].cn_nameoff = (uint32_t) (tablesize + pool.length);
+        cns[i].cn_dir = (uint32_t) (uintptr_t) kvs[i].value;
+        sb_ncat_force(&pool, kvs[i].key, strlen(kvs[i].key) + 1);
+        free(kvs[i].key);
+    }
+    free(kvs);
+    ht_destroy(&names);
+    for (size_t i = 0; i < dircount; i++)
+        cds[i].cd_nameoff += tablesize;
+
+    if (tablesize + pool.length > UINT32_MAX) {
+        free(cns);
+        sb_destroy(&pool);
+        return false;
+    }
+
+    cmdindex_header_T h;
+    memset(&h, 0, sizeof h);
+    memcpy(h.ch_magic, CMDINDEX_MAGIC, sizeof h.ch_magic);
+    h.ch_byteorder = 0x01020304;
+    h.ch_euid = (uint32_t) geteuid();
+    h.ch_egid = (uint32_t) getegid();
+    h.ch_dircount = (uint32_t) dircount;
+    h.ch_namecount = (uint32_t) namecount;
+    h.ch_size = (uint32_t) (tablesize + pool.length);
+
+    char *contents = xmalloc(h.ch_size);
+    char *p = contents;
+    memcpy(p, &h, sizeof h);
+    p += sizeof h;
+    memcpy(p, cds, dircount * sizeof *cds);
+    p += dircount * sizeof *cds;
+    memcpy(p, cns, namecount * sizeof *cns);
+    p += namecount * sizeof *cns;
+    memcpy(p, pool.contents, pool.length);
+    free(cns);
+    sb_destroy(&pool);
+
+    cmdindex.contents = contents;
+    cmdindex.size = h.ch_size;
+    cmdindex.mapped = false;
+    cmdindex.state = CI_READY;
+    return true;
+}
+
+/* Compares the keys of two `kvpair_T's that are multibyte strings by
+ * `strcmp'. */
+int cmdindex_key_cmp(const void *kv1, const void *kv2)
+{
+    return strcmp(((const kvpair_T *) kv1)->key, ((const kvpair_T *) kv2)->key);
+}
+
+/* Writes the current command index to the file named by $YASH_PATH_INDEX.
+ * The file is replaced atomically. Errors are silently ignored. */
+void save_cmdindex(void)
+{
+    assert(cmdindex.state == CI_READY);
+
+    const wchar_t *wfilename = getvar(L VAR_YASH_PATH_INDEX);
+    if (wfilename == NULL)
+        return;
+    char *filename = malloc_wcstombs(wfilename);
+    if (filename == NULL)
+        return;
+
+    /* The temporary file is created in the same directory so that it can be
+     * renamed to the index file. Its name is made unique by the process ID
+     * and a counter, which is incremented when a file of the name already
+     * exists, possibly left behind by a shell that had the same process ID
+     * and died before renaming the file. */
+    char *tempname = NULL;
+    int fd = -1;
+    for (unsigned i = 0; i < MAX_CMDINDEX_TEMP_TRIES; i++) {
+        free(tempname);
+        tempname = malloc_printf(
+                "%s.%jd.%u", filename, (intmax_t) shell_pid, i);
+        fd = open(tempname, O_WRONLY | O_CREAT | O_EXCL, 0600);
+        if (fd >= 0 || errno != EEXIST)
+            break;
+    }
+    if (fd >= 0) {
+        bool ok = true;
+        size_t written = 0;
+        while (written < cmdindex.size) {
+            ssize_t r = write(fd, cmdindex.contents + written,
+                    cmdindex.size - written);
+            if (r < 0) {
+                if (errno == EINTR)
+                    continue;
+                ok = false;
+                break;
+            }
+            written += (size_t) r;
+        }
+        if (xclose(fd) < 0)
+            ok = false;
+        if (!ok || rename(tempname, filename) < 0)
+            unlink(tempname);
+    }
+    free(tempname);
+    free(filename);
+}
+
+/* Looks up the specified command name in the command index.
+ * Returns the directory containing the command, or NULL if the command is not
+ * in the index. `*available' is set to whether the index was available. */
+const char *lookup_cmdindex(const char *name, bool *available)
+{
+    return lookup_cmdindex_rec(name, available, true);
+}
+
+const char *lookup_cmdindex_rec(const char *name, bool *available, bool recheck)
+{
+    const cmdindex_header_T *h = get_cmdindex();
+    *available = (h != NULL);
+    if (h == NULL)
+        return NULL;
+
+    const cmdindex_dir_T *cds = (const void *) &h[1];
+    const cmdindex_name_T *cns = (const void *) &cds[h->ch_dircount];
+    const cmdindex_name_T *cn = bsearch(name, cns, h->ch_namecount,
+            sizeof *cns, cmdindex_name_cmp);
+    if (cn == NULL) {
+        /* The command may have been installed since the last check of the
+         * directories. Check again to make sure it does not exist. */
+        if (!recheck)
+            return NULL;
+        cmdindex.checktime.tv_sec = -1;
+        return lookup_cmdindex_rec(name, available, false);
+    }
+    return &cmdindex.contents[cds[cn->cn_dir].cd_nameoff];
+}
+
+/* Compares a command name with the name of a `cmdindex_name_T'. */
+int cmdindex_name_cmp(const void *p1, const void *p2)
+{
+    const char *name = p1;
+    const cmdindex_name_T *cn = p2;
+    return strcmp(name, &cmdindex.contents[cn->cn_nameoff]);
+}
+
+/* Calls the specified function for each command name in the command index.
+ * Returns false if the index is not available. */
+bool foreach_cmdindex_name(void f(const char *name, void *data), void *data)
+{
+    const cmdindex_header_T *h = get_cmdindex();
+    if (h == NULL)
+        return false;
+
+    const cmdindex_dir_T *cds = (const void *) &h[1];
+    const cmdindex_name_T *cns = (const void *) &cds[h->ch_dircount];
+    for (uint32_t i = 0; i < h->ch_namecount; i++)
+        f(&cmdindex.contents[cns[i].cn_nameoff], data);
+    return true;
+}
+
+
 /********** Home Directory Cache **********/
 
 static struct passwd *xgetpwnam(const char *name)
@@ -554,12 +1342,13 @@ void forget_home_directory(const wchar_t *username)
 /* Parsed glob pattern component */
 struct wglob_pattern {
     enum {
-        WGLOB_LITERAL, WGLOB_MATCH, WGLOB_RECSEARCH,
+        WGLOB_LITERAL, WGLOB_CASELITERAL, WGLOB_MATCH, WGLOB_RECSEARCH,
     } type;
     union {
         struct {
             char *name;
             wchar_t *wname;
+            bool markdir;
         } literal;
         struct {
             xfnmatch_T *pattern;
@@ -569,6 +1358,18 @@ struct wglob_pattern {
         } recsearch;
     } value;
 };
+/* Each component is classified when the pattern is parsed:
+ * A WGLOB_LITERAL component matches exactly one filename. It is resolved by
+ * looking up the name directly rather than scanning the directory. Components
+ * without any wildcard are literal, and so are patterns that can match only
+ * one string, such as "fo[o]". `markdir' is true for the latter, as a pattern
+ * is subject to the WGLB_MARK flag.
+ * A WGLOB_CASELITERAL component is a pattern that matches one string ignoring
+ * case (such as "[Mm]akefile" with the WGLB_CASEFOLD flag). It requires
+ * scanning the directory, but each name is compared without regular
+ * expressions.
+ * A WGLOB_MATCH component is any other pattern, and a WGLOB_RECSEARCH
+ * component is a recursive search, e.g. "**". */
 
 /* Data used in search */
 struct wglob_search {
@@ -577,6 +1378,13 @@ struct wglob_search {
     xstrbuf_T path;
     xwcsbuf_T wpath;
     plist_T *results;
+#if HAVE_OPENAT
+    int basefd;
+    size_t baseoff;
+#endif
+#if HAVE_PTHREAD
+    struct wglob_worker *worker;
+#endif
 };
 /* `pattern' is an array of pointers to struct wglob_pattern objects. Each
  * wglob_pattern object is called a "component", which corresponds to one
@@ -584,7 +1392,28 @@ struct wglob_search {
  * `path' and `wpath' are intermediate pathnames, denoting the currently
  * searched directory. They are the multi-byte and wide string versions of the
  * same pathname. The multi-byte version is mainly used for calling OS APIs and
- * the wide version for producing the final results. */
+ * the wide version for producing the final results.
+ * `basefd' is a file descriptor of the directory being scanned (or AT_FDCWD)
+ * and `baseoff' is the length of its pathname in `path'. OS APIs are called
+ * with the pathname relative to `basefd', that is, `path.contents + baseoff',
+ * so that the kernel does not have to resolve the whole pathname again for
+ * every directory entry.
+ * `worker' is the thread performing the search in parallel search, or NULL in
+ * sequential search. */
+
+/* The type of a directory entry as reported by `readdir'. If `d_type' is not
+ * supported, or the constants are not defined because of the feature test
+ * macros, the values of 4.4BSD (which Linux also uses) are assumed. */
+#ifndef DT_UNKNOWN
+# define DT_UNKNOWN 0
+# define DT_DIR     4
+# define DT_LNK    10
+#endif
+#if HAVE_D_TYPE
+# define DIRENT_TYPE(de) ((de)->d_type)
+#else
+# define DIRENT_TYPE(de) DT_UNKNOWN
+#endif
 
 /* Data used in search for one level of directory */
 struct wglob_stack {
@@ -611,6 +1440,105 @@ struct wglob_stack {
  * intermediate path and produce a set of active components for the next path.
  */
 
+#if HAVE_PTHREAD
+
+/* When the WGLB_PARALLEL flag is specified, recursive search is performed by a
+ * pool of threads. Every subdirectory to be searched becomes a task, which is
+ * pushed to the deque of the worker that found the subdirectory. A worker takes
+ * tasks from the tail of its own deque and, when it is empty, steals one from
+ * the head of another worker's deque. This way, each worker mostly continues
+ * in the subtree it has been searching while large subtrees near the top are
+ * distributed among idle workers.
+ * Each worker adds results to its own list. The lists are merged and sorted
+ * after all the workers have finished, so the final result is the same as that
+ * of sequential search. */
+
+/* Maximum number of threads used in parallel search */
+#define WGLOB_MAX_THREADS 16
+
+/* Subdirectory to be searched */
+struct wglob_task {
+    struct wglob_stack *t;
+    char *path;
+    wchar_t *wpath;
+};
+
+/* Data for one thread in parallel search */
+struct wglob_worker {
+    struct wglob_pool *pool;
+    pthread_t thread;
+    struct wglob_search s;
+    plist_T tasks;
+    size_t taskhead;
+    plist_T results;
+    plist_T frames;
+};
+/* `tasks' is a deque of pending tasks (`struct wglob_task'). The tasks before
+ * index `taskhead' have already been stolen by other workers. `tasks' and
+ * `taskhead' are protected by the lock of the pool.
+ * `results' is the list of resulting pathnames found by this worker.
+ * `frames' is a list of stack frames created by this worker. Since a frame may
+ * be referred to as an ancestor by tasks performed by other workers, frames
+ * are not freed until the whole search is finished. */
+
+/* Thread pool for parallel search */
+struct wglob_pool {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    size_t pending;
+    size_t count;
+    struct wglob_worker workers[];
+};
+/* `pending' is the number of tasks that have been pushed but not yet finished.
+ * When it reaches zero, the search is done.
+ * `count' is the length of `workers'. The first worker is the main thread. */
+
+#endif /* HAVE_PTHREAD */
+
+/* Listings of directories scanned in wglob are cached so that repeated
+ * pathname expansion and completion do not read the same directories again.
+ * A listing is identified by the device and i-node numbers of the directory
+ * and is valid while the modification and status change times of the directory
+ * are unchanged. Directories modified within the last second are not cached
+ * since another modification in the same second might not change the time
+ * stamps.
+ * The cache is not used in parallel search. */
+
+/* Maximum number of directories in the cache */
+#define DIRCACHE_MAX_DIRS 1024
+/* Maximum total size of the names in the cache */
+#define DIRCACHE_MAX_SIZE (4 * 1024 * 1024)
+
+/* Cached listing of a directory */
+typedef struct dircache_T {
+    dev_t dc_dev;
+    ino_t dc_ino;
+    time_t dc_mtime, dc_ctime;
+    long dc_mtimensec;
+    unsigned long dc_lastuse;
+    unsigned dc_refcount;
+    size_t dc_count, dc_size;
+    unsigned char *dc_types;
+    char dc_names[];
+} dircache_T;
+/* `dc_names' contains `dc_count' null-terminated names of the directory
+ * entries, which occupy `dc_size' bytes in total, followed by the `dc_count'
+ * types of the entries, to which `dc_types' points.
+ * `dc_refcount' is the number of references to the listing from the cache and
+ * from scans currently iterating the listing. The listing is freed when the
+ * count reaches zero. */
+
+/* A hashtable that contains the cached listings. The keys and values are both
+ * pointers to `dircache_T', which are compared by the device and i-node
+ * numbers. */
+static hashtable_T dircache;
+/* True iff `dircache' has been initialized. */
+static bool dircache_initialized = false;
+/* Total of `dc_size' of the listings in `dircache' */
+static size_t dircache_size = 0;
+/* Counter to determine the least recently used listing */
+static unsigned long dircache_clock = 0;
+
 static plist_T wglob_parse_pattern(
         const wchar_t *pattern, enum wglobflags_T flags)
     __attribute__((nonnull,warn_unused_result));
@@ -620,6 +1548,11 @@ static struct wglob_pattern *wglob_parse_component(
 static struct wglob_pattern *wglob_create_recsearch_component(
         bool followlink, bool allowperiod)
     __attribute__((malloc,warn_unused_result));
+static wchar_t *wglob_literal_value(
+        const wchar_t *pattern, enum wglobflags_T flags)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static bool wglob_has_case(const wchar_t *s)
+    __attribute__((nonnull,pure));
 static void wglob_free_pattern(struct wglob_pattern *c);
 static void wglob_free_pattern_vp(void *c);
 
@@ -632,8 +1565,16 @@ static void wglob_search(
 static void wglob_search_literal_each(
         struct wglob_search *restrict s, const struct wglob_stack *restrict t)
     __attribute__((nonnull));
-static void wglob_add_result(
-        struct wglob_search *s, bool only_if_existing, bool markdir)
+static void wglob_add_result(struct wglob_search *s,
+        bool only_if_existing, bool markdir, unsigned char type)
+    __attribute__((nonnull));
+#if HAVE_OPENAT
+static const char *wglob_relpath(const struct wglob_search *s)
+    __attribute__((nonnull,pure));
+#endif
+static int wglob_stat(
+        const struct wglob_search *restrict s, struct stat *restrict st,
+        bool followlink)
     __attribute__((nonnull));
 static void wglob_search_literal_uniq(
         struct wglob_search *restrict s, struct wglob_stack *restrict t)
@@ -641,21 +1582,57 @@ static void wglob_search_literal_uniq(
 static bool wglob_scandir(
         struct wglob_search *restrict s, const struct wglob_stack *restrict t)
     __attribute__((nonnull));
+static bool wglob_use_dircache(
+        const struct wglob_search *restrict s, struct stat *restrict st)
+    __attribute__((nonnull));
+static dircache_T *dircache_get(const struct stat *st)
+    __attribute__((nonnull));
+static void dircache_put(const struct stat *restrict st,
+        const xstrbuf_T *restrict names, const xstrbuf_T *restrict types)
+    __attribute__((nonnull));
+static void dircache_evict(void);
+static void dircache_remove(dircache_T *dc)
+    __attribute__((nonnull));
+static void dircache_release(dircache_T *dc)
+    __attribute__((nonnull));
+static hashval_T hash_dircache(const void *dc)
+    __attribute__((nonnull,pure));
+static int compare_dircache(const void *dc1, const void *dc2)
+    __attribute__((nonnull,pure));
 static void wglob_scandir_entry(
-        const char *name, struct wglob_search *restrict s,
+        const char *name, unsigned char type, struct wglob_search *restrict s,
         const struct wglob_stack *restrict t, struct wglob_stack *restrict t2,
         bool only_if_existing)
     __attribute__((nonnull));
 static bool wglob_should_recurse(
-        const char *restrict name, const char *restrict path,
+        const char *restrict name, unsigned char type,
+        const struct wglob_search *restrict s,
         const struct wglob_pattern *restrict c, struct wglob_stack *restrict t,
         size_t count)
     __attribute__((nonnull));
 static bool wglob_is_reentry(const struct wglob_stack *const t, size_t count)
     __attribute__((nonnull,pure));
+static bool wglob_caseless_equal(const wchar_t *s1, const wchar_t *s2)
+    __attribute__((nonnull,pure));
 
-static int wglob_sortcmp(const void *v1, const void *v2)
-    __attribute__((pure,nonnull));
+static void wglob_stack_free(
+        struct wglob_search *restrict s, struct wglob_stack *restrict t)
+    __attribute__((nonnull));
+#if HAVE_PTHREAD
+static bool wglob_has_recsearch(const struct wglob_search *s)
+    __attribute__((nonnull,pure));
+static void wglob_search_parallel(
+        struct wglob_search *restrict s, const struct wglob_stack *restrict t)
+    __attribute__((nonnull));
+static size_t wglob_thread_count(void);
+static void *wglob_worker_main(void *w)
+    __attribute__((nonnull));
+static struct wglob_task *wglob_take_task(struct wglob_worker *w)
+    __attribute__((nonnull));
+static void wglob_push_task(
+        struct wglob_search *restrict s, const struct wglob_stack *restrict t)
+    __attribute__((nonnull));
+#endif
 
 /* A wide string version of `glob'.
  * Adds all pathnames that matches the specified pattern to the specified list.
@@ -666,6 +1643,8 @@ static int wglob_sortcmp(const void *v1, const void *v2)
  *          WGLB_PERIOD:   L'*' and L'?' match L'.' at the beginning
  *          WGLB_NOSORT:   don't sort resulting items
  *          WGLB_RECDIR:   allow recursive search with L"**"
+ *          WGLB_PARALLEL: search directories in parallel threads (ignored if
+ *                         WGLB_NOSORT is specified)
  * list:    a list of pointers to wide strings to which resulting items are
  *          added.
  * Returns true iff successful. However, some result items may be added to the
@@ -690,10 +1669,23 @@ bool wglob(const wchar_t *restrict pattern, enum wglobflags_T flags,
     sb_init(&s.path);
     wb_init(&s.wpath);
     s.results = list;
+#if HAVE_OPENAT
+    s.basefd = AT_FDCWD;
+    s.baseoff = 0;
+#endif
+#if HAVE_PTHREAD
+    s.worker = NULL;
+#endif
 
     struct wglob_stack *t = wglob_stack_new(&s, NULL);
     t->active_components[0] = 1;
 
+#if HAVE_PTHREAD
+    if ((flags & WGLB_PARALLEL) && !(flags & WGLB_NOSORT)
+            && wglob_has_recsearch(&s))
+        wglob_search_parallel(&s, t);
+    else
+#endif
     wglob_search(&s, t);
 
     free(t);
@@ -704,7 +1696,7 @@ bool wglob(const wchar_t *restrict pattern, enum wglobflags_T flags,
 
     if (!(flags & WGLB_NOSORT)) {
         size_t count = list->length - listbase;  /* # of resulting items */
-        qsort(list->contents + listbase, count, sizeof (void *), wglob_sortcmp);
+        collsort(list->contents + listbase, count, sizeof (void *), wcskeyof);
     }
     return !is_interrupted();
 }
@@ -761,7 +1753,21 @@ struct wglob_pattern *wglob_parse_component(
 
     struct wglob_pattern *result = xmalloc(sizeof *result);
 
-    if (is_matching_pattern(pattern)) {
+    if (!is_matching_pattern(pattern)) {
+        result->type = WGLOB_LITERAL;
+        result->value.literal.wname = unescape(pattern);
+        result->value.literal.markdir = false;
+        goto literal;
+    }
+
+    wchar_t *value = wglob_literal_value(pattern, flags);
+    if (value != NULL) {
+        result->type = (flags & WGLB_CASEFOLD) && wglob_has_case(value) ?
+            WGLOB_CASELITERAL : WGLOB_LITERAL;
+        result->value.literal.wname = value;
+        result->value.literal.markdir = true;
+        goto literal;
+    } else {
         xfnmflags_T xflags = XFNM_HEADONLY | XFNM_TAILONLY;
         if (flags & WGLB_CASEFOLD)
             xflags |= XFNM_CASEFOLD;
@@ -771,14 +1777,14 @@ struct wglob_pattern *wglob_parse_component(
         result->value.match.pattern = xfnm_compile(pattern, xflags);
         if (result->value.match.pattern == NULL)
             goto fail;
-    } else {
-        wchar_t *value = unescape(pattern);
-        result->type = WGLOB_LITERAL;
-        result->value.literal.wname = value;
-        result->value.literal.name = malloc_wcstombs(value);
-        if (result->value.literal.name == NULL)
-            goto fail;
+        return result;
     }
+
+literal:
+    result->value.literal.name =
+        malloc_wcstombs(result->value.literal.wname);
+    if (result->value.literal.name == NULL)
+        goto fail;
     return result;
 
 fail:
@@ -786,6 +1792,67 @@ fail:
     return NULL;
 }
 
+/* If the pattern component matches only one string, returns the string.
+ * Otherwise, returns NULL.
+ * Backslash escapes and bracket expressions that contain only one character are
+ * recognized. When the WGLB_CASEFOLD flag is specified, the characters in a
+ * bracket expression may differ in case. A bracket expression that contains
+ * any of "!-[\^" is conservatively regarded as matching more than one string.
+ * If the string starts with a period that would have to be matched by a
+ * bracket expression, NULL is returned since such a pattern matches nothing
+ * unless the WGLB_PERIOD flag is specified. */
+wchar_t *wglob_literal_value(const wchar_t *pattern, enum wglobflags_T flags)
+{
+    xwcsbuf_T buf;
+    wb_initwithmax(&buf, wcslen(pattern));
+
+    for (const wchar_t *p = pattern; *p != L'\0'; p++) {
+        switch (*p) {
+            case L'*':  case L'?':
+                goto fail;
+            case L'\\':
+                p++;
+                if (*p == L'\0')
+                    goto fail;
+                wb_wccat(&buf, *p);
+                break;
+            case L'[':;
+                wchar_t c = p[1];
+                if (c == L'\0' || wcschr(L"!-[\\]^", c) != NULL)
+                    goto fail;
+                for (p += 2; *p != L']'; p++) {
+                    if (*p == L'\0' || wcschr(L"!-[\\^", *p) != NULL)
+                        goto fail;
+                    if (*p != c && !((flags & WGLB_CASEFOLD) &&
+                                towlower((wint_t) *p) == towlower((wint_t) c)))
+                        goto fail;
+                }
+                if (c == L'.' && buf.length == 0 && !(flags & WGLB_PERIOD))
+                    goto fail;
+                wb_wccat(&buf, c);
+                break;
+            default:
+                wb_wccat(&buf, *p);
+                break;
+        }
+    }
+    return wb_towcs(&buf);
+
+fail:
+    wb_destroy(&buf);
+    return NULL;
+}
+
+/* Returns true iff `s' contains a character that has a different case. */
+bool wglob_has_case(const wchar_t *s)
+{
+    for (; *s != L'\0'; s++)
+        if (towlower((wint_t) *s) != (wint_t) *s
+                || towupper((wint_t) *s) != (wint_t) *s)
+            return true;
+    return false;
+}
+
 struct wglob_pattern *wglob_create_recsearch_component(
         bool followlink, bool allowperiod)
 {
@@ -803,6 +1870,7 @@ void wglob_free_pattern(struct wglob_pattern *c)
 
     switch (c->type) {
         case WGLOB_LITERAL:
+        case WGLOB_CASELITERAL:
             free(c->value.literal.name);
             free(c->value.literal.wname);
             break;
@@ -917,10 +1985,12 @@ void wglob_search_literal_each(
 
             wglob_search(s, t2);
 
-            free(t2);
+            wglob_stack_free(s, t2);
         } else {
             /* This is the last component. */
-            wglob_add_result(s, true, false);
+            wglob_add_result(s, true,
+                    c->value.literal.markdir && (s->flags & WGLB_MARK),
+                    DT_UNKNOWN);
         }
 
         sb_truncate(&s->path, savepathlen);
@@ -928,20 +1998,29 @@ void wglob_search_literal_each(
     }
 }
 
-/* Adds `s->path' to `s->results'. */
-void wglob_add_result(
-        struct wglob_search *s, bool only_if_existing, bool markdir)
+/* Adds `s->path' to `s->results'.
+ * `type' is the type of the file reported by `readdir' or DT_UNKNOWN. The file
+ * is `stat'ed only if the type is not enough to decide the result. */
+void wglob_add_result(struct wglob_search *s,
+        bool only_if_existing, bool markdir, unsigned char type)
 {
-    if (!only_if_existing && !markdir) {
+    if (!only_if_existing && (!markdir ||
+                (type != DT_UNKNOWN && type != DT_DIR && type != DT_LNK))) {
         pl_add(s->results, xwcsdup(s->wpath.contents));
         return;
     }
 
     struct stat st;
-    bool existing = stat(s->path.contents, &st) >= 0;
-    if (only_if_existing && !existing)
-        return;
-    if (!markdir || !existing || !S_ISDIR(st.st_mode)) {
+    bool isdir;
+    if (!only_if_existing && type == DT_DIR) {
+        isdir = true;
+    } else {
+        bool existing = wglob_stat(s, &st, true) >= 0;
+        if (only_if_existing && !existing)
+            return;
+        isdir = existing && S_ISDIR(st.st_mode);
+    }
+    if (!markdir || !isdir) {
         pl_add(s->results, xwcsdup(s->wpath.contents));
         return;
     }
@@ -982,7 +2061,7 @@ void wglob_search_literal_uniq(
     for (const kvpair_T *n = names; n->key != NULL; n++) {
         const struct wglob_pattern *c = n->value;
         memset(t2->active_components, 0, s->pattern.length);
-        wglob_scandir_entry(c->value.literal.name, s, t, t2, true);
+        wglob_scandir_entry(c->value.literal.name, DT_UNKNOWN, s, t, t2, true);
     }
 
     free(t2);
@@ -995,45 +2074,275 @@ void wglob_search_literal_uniq(
 bool wglob_scandir(
         struct wglob_search *restrict s, const struct wglob_stack *restrict t)
 {
+    struct stat st;
+    bool usecache = wglob_use_dircache(s, &st);
+    if (usecache) {
+        dircache_T *dc = dircache_get(&st);
+        if (dc != NULL) {
+            struct wglob_stack *t2 = wglob_stack_new(s, t);
+            wglob_scandir_entry("", DT_UNKNOWN, s, t, t2, true);
+
+            const char *name = dc->dc_names;
+            for (size_t i = 0; i < dc->dc_count; i++) {
+                memset(t2->active_components, 0, s->pattern.length);
+                wglob_scandir_entry(name, dc->dc_types[i], s, t, t2, false);
+                name += strlen(name) + 1;
+            }
+
+            dircache_release(dc);
+            free(t2);
+            return true;
+        }
+    }
+
+#if HAVE_OPENAT
+    int fd = openat(s->basefd, wglob_relpath(s), O_RDONLY | O_DIRECTORY);
+    if (fd < 0)
+        return false;
+    DIR *dir = fdopendir(fd);
+    if (dir == NULL) {
+        xclose(fd);
+        return false;
+    }
+
+    int savebasefd = s->basefd;
+    size_t savebaseoff = s->baseoff;
+    s->basefd = fd;
+    s->baseoff = s->path.length;
+#else
     DIR* dir = opendir((s->path.length == 0) ? "." : s->path.contents);
     if (dir == NULL)
         return false;
+#endif
 
     struct wglob_stack *t2 = wglob_stack_new(s, t);
 
     /* An empty name, which is needed for empty literal components, must be
      * explicitly produced as it would never be returned from readdir. */
-    wglob_scandir_entry("", s, t, t2, true);
+    wglob_scandir_entry("", DT_UNKNOWN, s, t, t2, true);
 
     /* now try each directory entry */
+    xstrbuf_T names, types;
+    if (usecache) {
+        sb_init(&names);
+        sb_init(&types);
+    }
     struct dirent *de;
     while ((de = readdir(dir)) != NULL) {
+        if (usecache) {
+            sb_ncat_force(&names, de->d_name, strlen(de->d_name) + 1);
+            sb_ccat(&types, TO_CHAR(DIRENT_TYPE(de)));
+        }
         memset(t2->active_components, 0, s->pattern.length);
-        wglob_scandir_entry(de->d_name, s, t, t2, false);
+        wglob_scandir_entry(de->d_name, DIRENT_TYPE(de), s, t, t2, false);
     }
     closedir(dir);
+    if (usecache) {
+        dircache_put(&st, &names, &types);
+        sb_destroy(&names);
+        sb_destroy(&types);
+    }
+
+#if HAVE_OPENAT
+    s->basefd = savebasefd;
+    s->baseoff = savebaseoff;
+#endif
 
     free(t2);
     return true;
 }
 
+/* Returns true if the directory `s->path' should be scanned through the
+ * directory listing cache, in which case `*st' is set to the result of
+ * `stat'ing the directory. */
+bool wglob_use_dircache(
+        const struct wglob_search *restrict s, struct stat *restrict st)
+{
+#if HAVE_PTHREAD
+    if (s->worker != NULL)
+        return false;
+#endif
+#if HAVE_OPENAT
+    return fstatat(s->basefd, wglob_relpath(s), st, 0) >= 0;
+#else
+    return stat((s->path.length == 0) ? "." : s->path.contents, st) >= 0;
+#endif
+}
+
+/* Returns the cached listing of the directory `st' with its reference count
+ * incremented, or NULL if there is no valid listing. An outdated listing of
+ * the directory is removed from the cache. */
+dircache_T *dircache_get(const struct stat *st)
+{
+    if (!dircache_initialized)
+        return NULL;
+
+    dircache_T key = { .dc_dev = st->st_dev, .dc_ino = st->st_ino, };
+    dircache_T *dc = ht_get(&dircache, &key).value;
+    if (dc == NULL)
+        return NULL;
+    if (dc->dc_mtime != st->st_mtime || dc->dc_ctime != st->st_ctime
+            || dc->dc_mtimensec != stat_mtimensec(st)) {
+        dircache_remove(dc);
+        return NULL;
+    }
+    dc->dc_lastuse = ++dircache_clock;
+    dc->dc_refcount++;
+    return dc;
+}
+
+/* Adds the listing of the directory `st' to the cache. `names' contains the
+ * null-terminated names of the entries and `types' their types. */
+void dircache_put(const struct stat *restrict st,
+        const xstrbuf_T *restrict names, const xstrbuf_T *restrict types)
+{
+    /* If the directory was modified within the last second, another
+     * modification in the same second might not change the time stamps. */
+    time_t now = time(NULL);
+    if (now == (time_t) -1
+            || st->st_mtime >= now - 1 || st->st_ctime >= now - 1)
+        return;
+    if (names->length > DIRCACHE_MAX_SIZE / 4)
+        return;
+
+    if (!dircache_initialized) {
+        ht_init(&dircache, hash_dircache, compare_dircache);
+        dircache_initialized = true;
+    }
+
+    dircache_T *dc = xmallocs(sizeof *dc,
+            add(names->length, types->length), sizeof *dc->dc_names);
+    dc->dc_dev = st->st_dev;
+    dc->dc_ino = st->st_ino;
+    dc->dc_mtime = st->st_mtime;
+    dc->dc_ctime = st->st_ctime;
+    dc->dc_mtimensec = stat_mtimensec(st);
+    dc->dc_lastuse = ++dircache_clock;
+    dc->dc_refcount = 1;
+    dc->dc_count = types->length;
+    dc->dc_size = names->length;
+    memcpy(dc->dc_names, names->contents, names->length);
+    dc->dc_types = (unsigned char *) &dc->dc_names[names->length];
+    memcpy(dc->dc_types, types->contents, types->length);
+
+    dircache_T *old = ht_get(&dircache, dc).value;
+    if (old != NULL)
+        dircache_remove(old);
+    if (dircache.count >= DIRCACHE_MAX_DIRS
+            || dircache_size + dc->dc_size > DIRCACHE_MAX_SIZE)
+        dircache_evict();
+
+    ht_set(&dircache, dc, dc);
+    dircache_size += dc->dc_size;
+}
+
+/* Removes about a half of the listings from the cache, in the least recently
+ * used order. */
+void dircache_evict(void)
+{
+    kvpair_T *kvs = ht_tokvarray(&dircache);
+    unsigned long oldest = dircache_clock, newest = 0;
+    for (size_t i = 0; kvs[i].key != NULL; i++) {
+        const dircache_T *dc = kvs[i].value;
+        if (oldest > dc->dc_lastuse)
+            oldest = dc->dc_lastuse;
+        if (newest < dc->dc_lastuse)
+            newest = dc->dc_lastuse;
+    }
+
+    unsigned long threshold = oldest + (newest - oldest) / 2;
+    for (size_t i = 0; kvs[i].key != NULL; i++)
+        if (((dircache_T *) kvs[i].value)->dc_lastuse <= threshold)
+            dircache_remove(kvs[i].value);
+    free(kvs);
+}
+
+/* Removes the listing from the cache. */
+void dircache_remove(dircache_T *dc)
+{
+    ht_remove(&dircache, dc);
+    dircache_size -= dc->dc_size;
+    dircache_release(dc);
+}
+
+/* Decrements the reference count of the listing and frees it if the count
+ * reaches zero. */
+void dircache_release(dircache_T *dc)
+{
+    assert(dc->dc_refcount > 0);
+    if (--dc->dc_refcount == 0)
+        free(dc);
+}
+
+/* Computes a hash value of the device and i-node numbers of the listing. */
+hashval_T hash_dircache(const void *dc)
+{
+    const dircache_T *d = dc;
+    return (hashval_T) d->dc_ino * FNVPRIME ^ (hashval_T) d->dc_dev;
+}
+
+/* Compares the device and i-node numbers of the listings.
+ * Returns zero iff they are the same. */
+int compare_dircache(const void *dc1, const void *dc2)
+{
+    const dircache_T *d1 = dc1, *d2 = dc2;
+    return d1->dc_dev != d2->dc_dev || d1->dc_ino != d2->dc_ino;
+}
+
+#if HAVE_OPENAT
+/* Returns the pathname `s->path' relative to `s->basefd'. */
+const char *wglob_relpath(const struct wglob_search *s)
+{
+    const char *relpath = &s->path.contents[s->baseoff];
+    if (s->baseoff > 0)
+        while (*relpath == '/')
+            relpath++;  /* "a//b" is the same as "a/b" */
+    return (*relpath == '\0') ? "." : relpath;
+}
+#endif
+
+/* Calls `stat' (or `lstat' if `followlink' is false) for `s->path'.
+ * The pathname is resolved relative to `s->basefd' if possible. */
+int wglob_stat(
+        const struct wglob_search *restrict s, struct stat *restrict st,
+        bool followlink)
+{
+#if HAVE_OPENAT
+    return fstatat(s->basefd, wglob_relpath(s), st,
+            followlink ? 0 : AT_SYMLINK_NOFOLLOW);
+#else
+    return (followlink ? stat : lstat)(s->path.contents, st);
+#endif
+}
+
 /* Checks if each active component matches the given `name' in the current
  * directory path and continues searching subdirectories.
+ * `type' is the type of the file reported by `readdir' or DT_UNKNOWN.
  * `t' is the stack frame for the current directory path and `t2' for the next
  * frame. `t2->prev' must be `t' and `t2->active_components' must have been
  * zeroed.
  * `only_if_existing' is passed to `wglob_add_result' and should be false iff
  * the `name' is known to be an existing file. */
 void wglob_scandir_entry(
-        const char *name, struct wglob_search *restrict s,
+        const char *name, unsigned char type, struct wglob_search *restrict s,
         const struct wglob_stack *restrict t, struct wglob_stack *restrict t2,
         bool only_if_existing)
 {
     size_t savepathlen = s->path.length, savewpathlen = s->wpath.length;
 
+    /* The wide version of the pathname is needed only if the entry matches
+     * any component, which is rare for most entries in recursive search. */
+    bool wpathready = false;
+#define PREPARE_WPATH()                                                 \
+    do {                                                                \
+        if (!wpathready) {                                              \
+            if (wb_mbscat(&s->wpath, name) != NULL)                     \
+                goto done; /* skip on error */                          \
+            wpathready = true;                                          \
+        }                                                               \
+    } while (0)
+
     sb_cat(&s->path, name);
-    if (wb_mbscat(&s->wpath, name) != NULL)
-        goto done; // skip on error
 
     /* add new active components to `t2' */
     for (size_t i = 0; i < s->pattern.length; i++) {
@@ -1045,40 +2354,71 @@ void wglob_scandir_entry(
             case WGLOB_LITERAL:
                 if (strcmp(c->value.literal.name, name) != 0)
                     continue;
-                if (i + 1 < s->pattern.length) // has a next component?
+                if (i + 1 < s->pattern.length) { // has a next component?
                     t2->active_components[i + 1] = 1;
-                else
-                    wglob_add_result(s, only_if_existing, false);
+                } else {
+                    PREPARE_WPATH();
+                    wglob_add_result(s, only_if_existing,
+                            c->value.literal.markdir && (s->flags & WGLB_MARK),
+                            type);
+                }
+                break;
+            case WGLOB_CASELITERAL:
+                if (name[0] == '\0')
+                    continue;
+                PREPARE_WPATH();
+                if (!wglob_caseless_equal(c->value.literal.wname,
+                            &s->wpath.contents[savewpathlen]))
+                    continue;
+                if (i + 1 < s->pattern.length) { // has a next component?
+                    t2->active_components[i + 1] = 1;
+                } else {
+                    wglob_add_result(s, only_if_existing,
+                            s->flags & WGLB_MARK, type);
+                }
                 break;
             case WGLOB_MATCH:
                 if (name[0] == '\0')
                     continue;
                 if (xfnm_match(c->value.match.pattern, name) != 0)
                     continue;
-                if (i + 1 < s->pattern.length) // has a next component?
+                if (i + 1 < s->pattern.length) { // has a next component?
                     t2->active_components[i + 1] = 1;
-                else
-                    wglob_add_result(s, only_if_existing, s->flags & WGLB_MARK);
+                } else {
+                    PREPARE_WPATH();
+                    wglob_add_result(s, only_if_existing,
+                            s->flags & WGLB_MARK, type);
+                }
                 break;
             case WGLOB_RECSEARCH:
                 assert(i + 1 < s->pattern.length);
                 if (name[0] == '\0')
                     continue;
                 if (t2->active_components[i] == 0) {
-                    const char *path = s->path.contents;
                     size_t count = t->active_components[i] - 1;
-                    if (wglob_should_recurse(name, path, c, t2, count))
+                    if (wglob_should_recurse(name, type, s, c, t2, count))
                         t2->active_components[i] = t->active_components[i] + 1;
                 }
                 break;
         }
     }
 
-    sb_ccat(&s->path, '/');
-    wb_wccat(&s->wpath, L'/');
-
     /* descend down to the next subdirectory */
-    wglob_search(s, t2);
+    for (size_t i = 0; i < s->pattern.length; i++) {
+        if (t2->active_components[i]) {
+            PREPARE_WPATH();
+            sb_ccat(&s->path, '/');
+            wb_wccat(&s->wpath, L'/');
+#if HAVE_PTHREAD
+            if (s->worker != NULL)
+                wglob_push_task(s, t2);
+            else
+#endif
+            wglob_search(s, t2);
+            break;
+        }
+    }
+#undef PREPARE_WPATH
 
 done:
     sb_truncate(&s->path, savepathlen);
@@ -1086,10 +2426,15 @@ done:
 }
 
 /* Decides if we should continue recursion on this component.
- * In this function, `t->st' is updated to the result of `stat'ing the `path'.
- */
+ * `type' is the type of the file `s->path' reported by `readdir' or
+ * DT_UNKNOWN.
+ * When following symbolic links, `t->st' is updated to the result of `stat'ing
+ * `s->path' to detect recursion into the same directory. Otherwise, the file
+ * is examined by `lstat' only if `type' is DT_UNKNOWN, since the directory
+ * hierarchy cannot have a loop without symbolic links. */
 bool wglob_should_recurse(
-        const char *restrict name, const char *restrict path,
+        const char *restrict name, unsigned char type,
+        const struct wglob_search *restrict s,
         const struct wglob_pattern *restrict c, struct wglob_stack *restrict t,
         size_t count)
 {
@@ -1101,9 +2446,16 @@ bool wglob_should_recurse(
             return false;
     }
 
-    int (*statfunc)(const char *path, struct stat *st) =
-        c->value.recsearch.followlink ? stat : lstat;
-    if (statfunc(path, &t->st) < 0)
+    if (!c->value.recsearch.followlink) {
+        if (type != DT_UNKNOWN)
+            return type == DT_DIR;
+        struct stat st;
+        return wglob_stat(s, &st, false) >= 0 && S_ISDIR(st.st_mode);
+    }
+
+    if (type != DT_UNKNOWN && type != DT_DIR && type != DT_LNK)
+        return false;
+    if (wglob_stat(s, &t->st, true) < 0)
         return false;
     if (!S_ISDIR(t->st.st_mode))
         return false;
@@ -1112,6 +2464,16 @@ bool wglob_should_recurse(
     return true;
 }
 
+/* Compares two strings ignoring case. */
+bool wglob_caseless_equal(const wchar_t *s1, const wchar_t *s2)
+{
+    for (; *s1 != L'\0'; s1++, s2++)
+        if (*s1 != *s2 && towlower((wint_t) *s1) != towlower((wint_t) *s2)
+                && towupper((wint_t) *s1) != towupper((wint_t) *s2))
+            return false;
+    return *s2 == L'\0';
+}
+
 /* Returns true iff a file that is the same as `t->st' appears in `count'
  * ancestors of `t'. */
 bool wglob_is_reentry(const struct wglob_stack *const t, size_t count)
@@ -1124,11 +2486,205 @@ bool wglob_is_reentry(const struct wglob_stack *const t, size_t count)
     return false;
 }
 
-int wglob_sortcmp(const void *v1, const void *v2)
+/* Frees the stack frame `t' after searching with it.
+ * In parallel search, the frame may be referred to by tasks that are still
+ * pending, so it is only remembered to be freed later. */
+void wglob_stack_free(
+        struct wglob_search *restrict s, struct wglob_stack *restrict t)
+{
+#if HAVE_PTHREAD
+    if (s->worker != NULL) {
+        pl_add(&s->worker->frames, t);
+        return;
+    }
+#endif
+    free(t);
+}
+
+#if HAVE_PTHREAD
+
+/* Returns true iff the pattern contains a recursive search component. */
+bool wglob_has_recsearch(const struct wglob_search *s)
+{
+    for (size_t i = 0; i < s->pattern.length; i++) {
+        const struct wglob_pattern *c = s->pattern.contents[i];
+        if (c->type == WGLOB_RECSEARCH)
+            return true;
+    }
+    return false;
+}
+
+/* Performs the search starting with `t' using a pool of threads.
+ * The results are added to `s->results' in an unspecified order. */
+void wglob_search_parallel(
+        struct wglob_search *restrict s, const struct wglob_stack *restrict t)
+{
+    size_t count = wglob_thread_count();
+    struct wglob_pool *pool =
+        xmallocs(sizeof *pool, count, sizeof *pool->workers);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+    pool->pending = 0;
+    pool->count = count;
+    for (size_t i = 0; i < count; i++) {
+        struct wglob_worker *w = &pool->workers[i];
+        w->pool = pool;
+        w->s.pattern = s->pattern;
+        w->s.flags = s->flags;
+        sb_init(&w->s.path);
+        wb_init(&w->s.wpath);
+        w->s.results = &w->results;
+#if HAVE_OPENAT
+        w->s.basefd = AT_FDCWD;
+        w->s.baseoff = 0;
+#endif
+        w->s.worker = w;
+        pl_init(&w->tasks);
+        w->taskhead = 0;
+        pl_init(&w->results);
+        pl_init(&w->frames);
+    }
+
+    wglob_push_task(&pool->workers[0].s, t);
+
+    /* The other threads must not handle signals for the shell. */
+    sigset_t ss, savess;
+    sigfillset(&ss);
+    pthread_sigmask(SIG_BLOCK, &ss, &savess);
+    size_t started = 1;
+    while (started < count && pthread_create(&pool->workers[started].thread,
+                NULL, wglob_worker_main, &pool->workers[started]) == 0)
+        started++;
+    pthread_sigmask(SIG_SETMASK, &savess, NULL);
+
+    wglob_worker_main(&pool->workers[0]);
+    for (size_t i = 1; i < started; i++)
+        pthread_join(pool->workers[i].thread, NULL);
+
+    for (size_t i = 0; i < count; i++) {
+        struct wglob_worker *w = &pool->workers[i];
+        assert(w->tasks.length == w->taskhead);
+        pl_ncat(s->results, w->results.contents, w->results.length);
+        pl_destroy(&w->results);
+        pl_destroy(&w->tasks);
+        plfree(pl_toary(&w->frames), free);
+        sb_destroy(&w->s.path);
+        wb_destroy(&w->s.wpath);
+    }
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+/* Returns the number of threads to be used in parallel search. */
+size_t wglob_thread_count(void)
 {
-    return wcscoll(*(const wchar_t *const *) v1, *(const wchar_t *const *) v2);
+    long count;
+#ifdef _SC_NPROCESSORS_ONLN
+    count = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    count = -1;
+#endif
+    /* Use at least two threads since directory scanning often waits for the
+     * disk rather than the processor. */
+    if (count < 2)
+        return 2;
+    if (count > WGLOB_MAX_THREADS)
+        return WGLOB_MAX_THREADS;
+    return (size_t) count;
+}
+
+/* Performs tasks until all the tasks in the pool are finished.
+ * The argument is a pointer to the `struct wglob_worker' for this thread. */
+void *wglob_worker_main(void *w_)
+{
+    struct wglob_worker *w = w_;
+    struct wglob_pool *pool = w->pool;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        struct wglob_task *task = wglob_take_task(w);
+        if (task == NULL) {
+            if (pool->pending == 0)
+                break;
+            pthread_cond_wait(&pool->cond, &pool->lock);
+            continue;
+        }
+        pthread_mutex_unlock(&pool->lock);
+
+        sb_cat(sb_clear(&w->s.path), task->path);
+        wb_cat(wb_clear(&w->s.wpath), task->wpath);
+        free(task->path);
+        free(task->wpath);
+        wglob_search(&w->s, task->t);
+        free(task);
+
+        pthread_mutex_lock(&pool->lock);
+        assert(pool->pending > 0);
+        if (--pool->pending == 0)
+            pthread_cond_broadcast(&pool->cond);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/* Removes a task from the tail of the deque of `w' or, if it is empty, from
+ * the head of the deque of another worker.
+ * Returns NULL if no task is available.
+ * The caller must hold the lock of the pool. */
+struct wglob_task *wglob_take_task(struct wglob_worker *w)
+{
+    struct wglob_task *task;
+    if (w->tasks.length > w->taskhead) {
+        task = w->tasks.contents[w->tasks.length - 1];
+        pl_truncate(&w->tasks, w->tasks.length - 1);
+    } else {
+        struct wglob_pool *pool = w->pool;
+        size_t self = (size_t) (w - pool->workers);
+        for (size_t i = 1; ; i++) {
+            if (i >= pool->count)
+                return NULL;
+
+            struct wglob_worker *v = &pool->workers[(self + i) % pool->count];
+            if (v->tasks.length > v->taskhead) {
+                task = v->tasks.contents[v->taskhead++];
+                w = v;
+                break;
+            }
+        }
+    }
+    if (w->tasks.length == w->taskhead) {
+        pl_truncate(&w->tasks, 0);
+        w->taskhead = 0;
+    }
+    return task;
+}
+
+/* Makes the current directory path `s->path' a new task that is searched with
+ * a copy of `t', and pushes it to the tail of the deque of `s->worker'. */
+void wglob_push_task(
+        struct wglob_search *restrict s, const struct wglob_stack *restrict t)
+{
+    struct wglob_stack *t2 = wglob_stack_new(s, t->prev);
+    t2->st = t->st;
+    memcpy(t2->active_components, t->active_components, s->pattern.length);
+    pl_add(&s->worker->frames, t2);
+
+    struct wglob_task *task = xmalloc(sizeof *task);
+    task->t = t2;
+    task->path = xstrdup(s->path.contents);
+    task->wpath = xwcsdup(s->wpath.contents);
+
+    struct wglob_pool *pool = s->worker->pool;
+    pthread_mutex_lock(&pool->lock);
+    pl_add(&s->worker->tasks, task);
+    pool->pending++;
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
 }
 
+#endif /* HAVE_PTHREAD */
+
 
 /********** Built-ins **********/
 
@@ -1659,7 +3215,8 @@ void print_command_paths(bool all)
     size_t index = 0;
 
     while ((kv = ht_next(&cmdhash, &index)).key != NULL) {
-        const char *path = kv.value;
+        const cmdpath_T *cp = kv.value;
+        const char *path = cp->cp_path;
         if (path[0] != '/')
             continue;
         if (all || get_builtin(kv.key) == NULL) {
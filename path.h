@@ -63,6 +63,9 @@ extern char *which(
         _Bool cond(const char *path))
     __attribute__((nonnull(1),malloc,warn_unused_result));
 
+extern char *which_loadpath(const char *name)
+    __attribute__((nonnull,malloc,warn_unused_result));
+
 extern int create_temporary_file(
         char **restrict filename, const char *restrict suffix, mode_t mode)
     __attribute__((nonnull));
@@ -74,11 +77,21 @@ extern void init_cmdhash(void);
 extern void clear_cmdhash(void);
 extern const char *get_command_path(const char *name, _Bool forcelookup)
     __attribute__((nonnull));
+extern const char *refresh_command_path(const char *path)
+    __attribute__((nonnull));
 extern void fill_cmdhash(const char *prefix, _Bool ignorecase);
 extern const char *get_command_path_default(const char *name)
     __attribute__((nonnull));
 
 
+/********** Persistent Command Index **********/
+
+extern void clear_cmdindex(void);
+extern _Bool foreach_cmdindex_name(
+        void f(const char *name, void *data), void *data)
+    __attribute__((nonnull(1)));
+
+
 /********** Home Directory Cache **********/
 
 extern void init_homedirhash(void);
@@ -95,6 +108,7 @@ enum wglobflags_T {
     WGLB_PERIOD   = 1 << 2,
     WGLB_NOSORT   = 1 << 3,
     WGLB_RECDIR   = 1 << 4,
+    WGLB_PARALLEL = 1 << 5,
 };
 
 struct plist_T;
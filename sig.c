@@ -1063,6 +1063,12 @@ void set_interrupted(void)
     sigint_received = true;
 }
 
+/* Clears the `sigint_received' flag. */
+void reset_interrupted(void)
+{
+    sigint_received = false;
+}
+
 #if YASH_ENABLE_LINEEDIT
 
 #ifdef SIGWINCH
@@ -1283,9 +1289,12 @@ bool print_trap(const wchar_t *signame, const wchar_t *command)
     if (command == NULL)
         return true;
 
-    wchar_t *q = quote_as_word(command);
-    bool ok = xprintf("trap -- %ls %ls\n", q, signame);
-    free(q);
+    wchar_t array[XWCSBUF_STACKSIZE];
+    xwcsbuf_T q;
+    wb_initwithstack(&q, array, XWCSBUF_STACKSIZE);
+    bool ok = xprintf("trap -- %ls %ls\n",
+            wb_quote_as_word(&q, command)->contents, signame);
+    wb_destroy(&q);
     return ok;
 }
 
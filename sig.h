@@ -59,6 +59,7 @@ extern void phantomize_traps(void);
 extern _Bool is_interrupted(void);
 extern void set_laststatus_if_interrupted(void);
 extern void set_interrupted(void);
+extern void reset_interrupted(void);
 #if YASH_ENABLE_LINEEDIT
 extern void reset_sigwinch(void);
 #endif
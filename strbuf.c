@@ -51,6 +51,26 @@ xstrbuf_T *sb_initwithmax(xstrbuf_T *buf, size_t max)
     buf->contents[0] = '\0';
     buf->length = 0;
     buf->maxlength = max;
+    buf->onstack = false;
+    return buf;
+}
+
+/* Initializes the specified string buffer as an empty string that uses the
+ * specified array of `size' bytes as its initial storage.
+ * The array must remain valid until the buffer is destroyed or converted by
+ * `sb_tostr'. If the buffer grows beyond the array, the contents are moved to
+ * a newly malloced memory. This allows short transient strings to be built
+ * without any memory allocation.
+ * `size' must be positive. */
+xstrbuf_T *sb_initwithstack(
+        xstrbuf_T *restrict buf, char *restrict array, size_t size)
+{
+    assert(size > 0);
+    buf->contents = array;
+    buf->contents[0] = '\0';
+    buf->length = 0;
+    buf->maxlength = size - 1;
+    buf->onstack = true;
     return buf;
 }
 
@@ -62,6 +82,7 @@ xstrbuf_T *sb_initwith(xstrbuf_T *restrict buf, char *restrict s)
 {
     buf->contents = s;
     buf->length = buf->maxlength = strlen(s);
+    buf->onstack = false;
     return buf;
 }
 
@@ -70,8 +91,16 @@ xstrbuf_T *sb_initwith(xstrbuf_T *restrict buf, char *restrict s)
  * the buffer contents is truncated. */
 xstrbuf_T *sb_setmax(xstrbuf_T *buf, size_t newmax)
 {
-    // buf->contents = xrealloce(buf->contents, newmax, 1, sizeof (char));
-    buf->contents = xrealloc(buf->contents, add(newmax, 1));
+    if (buf->onstack) {
+        char *newcontents = xmalloc(add(newmax, 1));
+        memcpy(newcontents, buf->contents,
+                (buf->length < newmax ? buf->length : newmax) + 1);
+        buf->contents = newcontents;
+        buf->onstack = false;
+    } else {
+        // buf->contents = xrealloce(buf->contents, newmax, 1, sizeof (char));
+        buf->contents = xrealloc(buf->contents, add(newmax, 1));
+    }
     buf->maxlength = newmax;
     buf->contents[newmax] = '\0';
     if (newmax < buf->length)
@@ -321,6 +350,25 @@ xwcsbuf_T *wb_initwithmax(xwcsbuf_T *buf, size_t max)
     buf->contents[0] = L'\0';
     buf->length = 0;
     buf->maxlength = max;
+    buf->onstack = false;
+    return buf;
+}
+
+/* Initializes the specified wide string buffer as an empty string that uses
+ * the specified array of `size' wide characters as its initial storage.
+ * The array must remain valid until the buffer is destroyed or converted by
+ * `wb_towcs'. If the buffer grows beyond the array, the contents are moved to
+ * a newly malloced memory.
+ * `size' must be positive. */
+xwcsbuf_T *wb_initwithstack(
+        xwcsbuf_T *restrict buf, wchar_t *restrict array, size_t size)
+{
+    assert(size > 0);
+    buf->contents = array;
+    buf->contents[0] = L'\0';
+    buf->length = 0;
+    buf->maxlength = size - 1;
+    buf->onstack = true;
     return buf;
 }
 
@@ -332,6 +380,7 @@ xwcsbuf_T *wb_initwith(xwcsbuf_T *restrict buf, wchar_t *restrict s)
 {
     buf->contents = s;
     buf->length = buf->maxlength = wcslen(s);
+    buf->onstack = false;
     return buf;
 }
 
@@ -340,7 +389,15 @@ xwcsbuf_T *wb_initwith(xwcsbuf_T *restrict buf, wchar_t *restrict s)
  * the buffer contents is truncated. */
 xwcsbuf_T *wb_setmax(xwcsbuf_T *buf, size_t newmax)
 {
-    buf->contents = xrealloce(buf->contents, newmax, 1, sizeof (wchar_t));
+    if (buf->onstack) {
+        wchar_t *newcontents = xmalloce(newmax, 1, sizeof (wchar_t));
+        wmemcpy(newcontents, buf->contents,
+                (buf->length < newmax ? buf->length : newmax) + 1);
+        buf->contents = newcontents;
+        buf->onstack = false;
+    } else {
+        buf->contents = xrealloce(buf->contents, newmax, 1, sizeof (wchar_t));
+    }
     buf->maxlength = newmax;
     buf->contents[newmax] = L'\0';
     if (newmax < buf->length)
@@ -31,16 +31,30 @@
 #ifndef XWCSBUF_INITSIZE
 #define XWCSBUF_INITSIZE 15
 #endif
+/* sizes of automatic arrays for `sb_initwithstack' and `wb_initwithstack' in
+ * functions that build short transient strings */
+#ifndef XSTRBUF_STACKSIZE
+#define XSTRBUF_STACKSIZE 64
+#endif
+#ifndef XWCSBUF_STACKSIZE
+#define XWCSBUF_STACKSIZE 64
+#endif
 
 
 typedef struct xstrbuf_T {
     char *contents;
     size_t length, maxlength;
+    _Bool onstack;
 } xstrbuf_T;
 typedef struct xwcsbuf_T {
     wchar_t *contents;
     size_t length, maxlength;
+    _Bool onstack;
 } xwcsbuf_T;
+/* `onstack' is true iff `contents' points to an array provided by the caller
+ * of `sb_initwithstack' or `wb_initwithstack' (typically an automatic array)
+ * rather than to `malloc'ed memory. Such a buffer is moved to the heap when it
+ * grows beyond the array or when `sb_tostr' or `wb_towcs' is called. */
 
 static inline xstrbuf_T *sb_init(xstrbuf_T *buf)
     __attribute__((nonnull));
@@ -48,6 +62,9 @@ extern xstrbuf_T *sb_initwith(xstrbuf_T *restrict buf, char *restrict s)
     __attribute__((nonnull));
 extern xstrbuf_T *sb_initwithmax(xstrbuf_T *buf, size_t max)
     __attribute__((nonnull));
+extern xstrbuf_T *sb_initwithstack(
+        xstrbuf_T *restrict buf, char *restrict array, size_t size)
+    __attribute__((nonnull));
 static inline void sb_destroy(xstrbuf_T *buf)
     __attribute__((nonnull));
 static inline char *sb_tostr(xstrbuf_T *buf)
@@ -122,6 +139,9 @@ extern xwcsbuf_T *wb_initwith(xwcsbuf_T *restrict buf, wchar_t *restrict s)
     __attribute__((nonnull));
 extern xwcsbuf_T *wb_initwithmax(xwcsbuf_T *buf, size_t max)
     __attribute__((nonnull));
+extern xwcsbuf_T *wb_initwithstack(
+        xwcsbuf_T *restrict buf, wchar_t *restrict array, size_t size)
+    __attribute__((nonnull));
 static inline void wb_destroy(xwcsbuf_T *buf)
     __attribute__((nonnull));
 static inline wchar_t *wb_towcs(xwcsbuf_T *buf)
@@ -214,13 +234,23 @@ xstrbuf_T *sb_init(xstrbuf_T *buf)
 /* Frees the specified multibyte string buffer. The contents are lost. */
 void sb_destroy(xstrbuf_T *buf)
 {
-    free(sb_tostr(buf));
+    if (!buf->onstack) {
+        free(sb_tostr(buf));
+    } else {
+#ifndef NDEBUG
+        buf->contents = NULL;
+        buf->length = buf->maxlength = Size_max;
+#endif
+    }
 }
 
 /* Frees the specified multibyte string buffer and returns the contents.
  * The caller must `free' the return value. */
 char *sb_tostr(xstrbuf_T *buf)
 {
+    if (buf->onstack)
+        sb_setmax(buf, buf->length);
+
     char *s = buf->contents;
 #ifndef NDEBUG
     buf->contents = &s[buf->maxlength];
@@ -336,13 +366,23 @@ xwcsbuf_T *wb_init(xwcsbuf_T *buf)
 /* Frees the specified wide string buffer. The contents are lost. */
 void wb_destroy(xwcsbuf_T *buf)
 {
-    free(wb_towcs(buf));
+    if (!buf->onstack) {
+        free(wb_towcs(buf));
+    } else {
+#ifndef NDEBUG
+        buf->contents = NULL;
+        buf->length = buf->maxlength = Size_max;
+#endif
+    }
 }
 
 /* Frees the specified wide string buffer and returns the contents.
  * The caller must `free' the return value. */
 wchar_t *wb_towcs(xwcsbuf_T *buf)
 {
+    if (buf->onstack)
+        wb_setmax(buf, buf->length);
+
     wchar_t *s = buf->contents;
 #ifndef NDEBUG
     buf->contents = &s[buf->maxlength];
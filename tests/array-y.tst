@@ -84,6 +84,30 @@ __IN__
 [b][c]
 __OUT__
 
+test_oE -e 0 'appending to array'
+a=(a)
+a+=(b 'c  c')
+a+=d
+a+=()
+bracket "$a"
+__IN__
+[a][b][c  c][d]
+__OUT__
+
+test_oE -e 0 'appending array to scalar variable'
+a='1  1' b=
+a+=(2 3) b+=(x) c+=(y)
+bracket "$a" - "$b" - "$c"
+__IN__
+[1  1][2][3][-][][x][-][y]
+__OUT__
+
+test_O -d -e n 'appending to read-only array'
+a=(a)
+readonly a
+a+=(b)
+__IN__
+
 # Below are tests of the array built-in.
 if ! testee --version --verbose | grep -Fqx ' * array'; then
     skip="true"
@@ -531,6 +531,14 @@ __IN__
 }
 __OUT__
 
+test_multi 'appending assignment'
+{ foo+= bar+=BAR baz+=(1 2); }
+__IN__
+{
+   foo+= bar+=BAR baz+=(1 2)
+}
+__OUT__
+
 test_multi 'single-line redirections'
 { <f >g 2>|h 10>>i <>j <&1 >&2 >>|"3" <<<here\ string; }
 __IN__
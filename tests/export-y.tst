@@ -16,6 +16,20 @@ export -p >withp.out
 diff withoutp.out withp.out
 __IN__
 
+test_oE -e 0 'variables inherited from environment'
+env_1=1 env_2=2 env_3=3 "$TESTEE" -c '
+echo "$env_2"
+unset env_3
+export -p | grep "^export env_"
+sh -c "echo \${env_3-unset}"
+'
+__IN__
+2
+export env_1=1
+export env_2=2
+unset
+__OUT__
+
 test_oE -e 0 'assigning empty value'
 export a=
 export -p a
@@ -63,6 +63,60 @@ __IN__
 Running c/command1
 __OUT__
 
+export TEST_NO="$LINENO"
+test_oE 'remembered command path of removed command'
+mkdir a b c
+PATH=$PWD/a:$PWD/b:$PWD/c:$PATH
+make_command a/command1 b/command1 c/command1
+command1
+rm a/command1
+command1
+chmod a-x b/command1
+command1
+__IN__
+Running a/command1
+Running b/command1
+Running c/command1
+__OUT__
+
+export TEST_NO="$LINENO"
+test_oE 'finding commands with command index'
+mkdir a b
+echo broken >index
+YASH_PATH_INDEX=$PWD/index PATH=$PWD/a:$PWD/b:$PATH
+make_command b/command1
+command1
+command -v command2 || echo not found
+make_command a/command2
+command2
+hash -r
+command1
+command2
+__IN__
+Running b/command1
+not found
+Running a/command2
+Running b/command1
+Running a/command2
+__OUT__
+
+export TEST_NO="$LINENO"
+test_oE 'command index is built after YASH_PATH_INDEX is set'
+mkdir a
+make_command a/command1 a/command2
+sleep 2
+PATH=$PWD/a:$PATH
+command1
+if [ -e index ]; then echo index exists; fi
+YASH_PATH_INDEX=$PWD/index
+command2
+if [ -e index ]; then echo index exists; fi
+__IN__
+Running a/command1
+Running a/command2
+index exists
+__OUT__
+
 export TEST_NO="$LINENO"
 test_oE 'removing specific remembered command path'
 mkdir a b c
@@ -778,10 +778,12 @@ Options:
 	         -o forlocal
 	+f       -o glob
 	-h       -o hashondef
+	         -o histbinary
 	         -o histspace
 	         -o ignoreeof
 	-i       -o interactive
 	         -o lealwaysrp
+	         -o lecompcancel
 	         -o lecompdebug
 	         -o leconvmeta
 	         -o lenoconvmeta
@@ -797,6 +799,7 @@ Options:
 	-b       -o notify
 	         -o notifyle
 	         -o nullglob
+	         -o parallelglob
 	         -o pipefail
 	         -o posixlycorrect
 	-s       -o stdin
@@ -204,6 +204,32 @@ __OUT__
 
 )
 
+(
+export histfile=histfile$LINENO histsize=100 histrmdup=2
+
+test_oE 'HISTRMDUP after deleting entries' -i +m --rcfile="rcfile2"
+echo foo
+echo bar
+echo baz
+history -d 3
+echo bar
+echo foo
+fc -l
+__IN__
+foo
+bar
+baz
+bar
+foo
+1	echo foo
+4	history -d 3
+5	echo bar
+6	echo foo
+7	fc -l
+__OUT__
+
+)
+
 (
 export histfile=histfile$LINENO histsize=5 histrmdup=5
 
@@ -335,4 +361,46 @@ __OUT__
 
 )
 
+(
+export histfile=histfile$LINENO histsize=50
+
+# Prepare history entries w/o running a test case.
+# The text history file is converted to the binary format by the second shell.
+[ "${skip-}" ] ||
+    testee -is +m --rcfile="rcfile1" >/dev/null <<\__END__
+echo foo 1
+echo foo 2
+__END__
+[ "${skip-}" ] ||
+    testee -is +m --rcfile="rcfile1" -o histbinary >/dev/null <<\__END__
+echo foo 3
+history -d 2
+echo foo 4
+__END__
+
+test_oE -e 0 'histbinary option' -i +m --rcfile="rcfile1" -o histbinary
+dd bs=8 count=1 if="$HISTFILE" 2>/dev/null | tr '\0' @; echo
+fc -l
+__IN__
+@yash-h1
+1	echo foo 1
+2	echo foo 3
+3	history -d 2
+4	echo foo 4
+5	dd bs=8 count=1 if="$HISTFILE" 2>/dev/null | tr '\0' @; echo
+6	fc -l
+__OUT__
+
+test_oE -e 0 'binary history file is converted to text' -i +m --rcfile="rcfile1"
+head -n 1 "$HISTFILE"
+fc -l 1 3
+__IN__
+#$# yash history v0 r3
+1	echo foo 1
+2	echo foo 3
+3	history -d 2
+__OUT__
+
+)
+
 # vim: set ft=sh ts=8 sts=4 sw=4 et:
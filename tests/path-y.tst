@@ -16,6 +16,18 @@ Caseglob1 caseglob2
 Caseglob1 caseglob2
 __OUT__
 
+test_oE 'caseglob on: bracket expression with one character' --caseglob
+echo caseglob[2] caseglob[1] [C]aseglob1 [Cc]aseglob2
+__IN__
+caseglob2 caseglob[1] Caseglob1 caseglob2
+__OUT__
+
+test_oE 'caseglob off: bracket expression with one character' --nocaseglob
+echo caseglob[1] CASEGLOB[2] [Cc]aseglob1 [cC]ASEGLOB2
+__IN__
+Caseglob1 caseglob2 Caseglob1 caseglob2
+__OUT__
+
 (
 mkdir dotglob
 cd dotglob
@@ -48,6 +60,8 @@ mkdir markdirs
 cd markdirs
 >regular
 mkdir directory
+ln -s directory lnkd
+ln -s regular lnkf
 )
 
 (
@@ -59,6 +73,18 @@ __IN__
 directory/ regular
 __OUT__
 
+test_oE 'markdirs on: bracket expression with one character' --markdirs
+echo direc[t]ory regula[r] [.]/directory
+__IN__
+directory/ regular [.]/directory
+__OUT__
+
+test_oE 'markdirs on: symbolic links' --markdirs
+echo lnk*
+__IN__
+lnkd/ lnkf
+__OUT__
+
 test_oE 'markdirs off: effect' --nomarkdirs
 echo *r*
 __IN__
@@ -108,6 +134,20 @@ anotherdir/file
 dir/dir/file
 __OUT__
 
+test_oE 'parallelglob on: effect' --extendedglob --parallelglob
+echo **/file
+echo ***/file
+echo .**/file
+echo .***/file
+echo **/**/f*e
+__IN__
+anotherdir/file dir/dir/file
+anotherdir/file anotherdir/loop/dir/file dir/dir/file dir/dir/link/file
+.dir/dir/file .dir/file anotherdir/file dir/.dir/file dir/dir/file
+.dir/dir/file .dir/file anotherdir/file anotherdir/loop/.dir/file anotherdir/loop/dir/file dir/.dir/file dir/dir/.link/file dir/dir/file dir/dir/link/file
+anotherdir/file dir/dir/file
+__OUT__
+
 )
 
 (
@@ -567,6 +607,16 @@ b/b/a/b/a/b/b/a
 b/b/b/a/b/a/b/a
 __OUT__
 
+test_oE 'parallelglob yields the same result as sequential search' \
+    --extendedglob
+sequential="$(printf '%s\n' **/a/**/b ***/a/a/b a/**/b/**/a)"
+set -o parallelglob
+parallel="$(printf '%s\n' **/a/**/b ***/a/a/b a/**/b/**/a)"
+[ "$parallel" = "$sequential" ] && echo same
+__IN__
+same
+__OUT__
+
 )
 
 mkdir nullglob
@@ -590,4 +640,34 @@ __OUT__
 
 )
 
+(
+if ! testee -c 'command -bv ulimit' >/dev/null; then
+    skip="true"
+fi
+
+# A directory modified within the last second is not cached, so the test waits
+# before the first expansion. With "ulimit -n 3", no directory can be opened,
+# so an expansion that still lists the directory must be served from the cache.
+test_oE 'expansion results reflect modification of cached directory'
+mkdir listing
+>listing/a
+>listing/b
+sleep 2
+echo listing/*
+(ulimit -n 3 && echo listing/*)
+rm listing/a
+echo listing/*
+>listing/c
+echo listing/*
+(ulimit -n 3 && echo listing/*)
+__IN__
+listing/a listing/b
+listing/a listing/b
+listing/b
+listing/b listing/c
+listing/*
+__OUT__
+
+)
+
 # vim: set ft=sh ts=8 sts=4 sw=4 et:
@@ -205,6 +205,7 @@ test_long_option_default_off "$LINENO" markdirs
 # The monitor option cannot be tested here due to dependency on the terminal.
 test_long_option_default_off "$LINENO" notify
 test_long_option_default_off "$LINENO" nullglob
+test_long_option_default_off "$LINENO" parallelglob
 test_long_option_default_off "$LINENO" pipefail
 # This needs a special test (see below)
 #test_long_option_default_off "$LINENO" posixlycorrect
@@ -217,6 +218,7 @@ test_long_option_default_off "$LINENO" xtrace
 if ! testee --version --verbose | grep -Fqx ' * history'; then
     skip="true"
 fi
+test_long_option_default_off "$LINENO" histbinary
 test_long_option_default_off "$LINENO" histspace
 )
 (
@@ -225,6 +227,7 @@ if ! testee --version --verbose | grep -Fqx ' * lineedit'; then
 fi
 test_long_option_default_off "$LINENO" emacs
 test_long_option_default_off "$LINENO" lealwaysrp
+test_long_option_default_off "$LINENO" lecompcancel
 test_long_option_default_off "$LINENO" lecompdebug
 test_long_option_default_off "$LINENO" leconvmeta
 test_long_option_default_off "$LINENO" lenoconvmeta
@@ -391,7 +394,7 @@ set -o
 __IN__
 
 test_oE 'set -o: output'
-set -o | grep -v '^histspace ' |
+set -o | grep -v '^hist' |
 grep -v '^le' | grep -v '^emacs ' | grep -v '^notifyle ' | grep -v '^vi '
 echo ---
 set -a +o caseglob -o dotglob
@@ -422,6 +425,7 @@ markdirs        off
 monitor         off
 notify          off
 nullglob        off
+parallelglob    off
 pipefail        off
 posixlycorrect  off
 stdin           on
@@ -453,6 +457,7 @@ test_oE 'set +o: output'
 set +o |
 grep -v '^set [+-]o le' |
 grep -Fvx 'set +o emacs' |
+grep -Fvx 'set +o histbinary' |
 grep -Fvx 'set +o histspace' |
 grep -Fvx 'set +o notifyle' |
 grep -Fvx 'set +o vi'
@@ -479,6 +484,7 @@ set +o markdirs
 set +o monitor
 set +o notify
 set +o nullglob
+set +o parallelglob
 set +o pipefail
 set +o posixlycorrect
 set -o traceall
@@ -45,6 +45,34 @@ __IN__
 [3][][-][j]
 __OUT__
 
+test_oE -e 0 'array modified after shift'
+a=(1 2 3 4 5)
+shift -A a 2
+array -i a 0 x
+array -s a 2 y
+array -d a -1
+shift -A a -1
+bracket "${a[#]}" "$a"
+a=(1 2 3)
+shift -A a
+a=("$a" 4 5)
+bracket "${a[#]}" "$a"
+__IN__
+[2][x][y]
+[4][2][3][4][5]
+__OUT__
+
+test_oE -e 0 'repeated shifts of positional parameters' -s 1 2 3 4 5 6 7
+while [ "$#" -gt 2 ]; do shift; done
+bracket "$#" "$@" "$1"
+set -- "$@" 8
+shift
+bracket "$#" "$@"
+__IN__
+[2][6][7][6]
+[2][7][8]
+__OUT__
+
 test_o 'positional parameters are not modified on error' -s a 'b  b' c
 shift 4
 bracket "$#" "$@"
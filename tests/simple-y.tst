@@ -33,6 +33,49 @@ __IN__
 1
 __OUT__
 
+test_oE 'appending assignment'
+a=foo b= unset c
+a+=bar b+=' x' c+=c
+bracket "$a" "$b" "$c"
+for i in 1 2 3; do a+=-$i; done
+bracket "$a"
+__IN__
+[foobar][ x][c]
+[foobar-1-2-3]
+__OUT__
+
+test_oE 'appending assignment to exported and local variables'
+export a=A
+a+=B
+sh -c 'echo $a'
+f() { typeset a; a=L; a+=M; echo $a; }
+f
+echo $a
+__IN__
+AB
+LM
+AB
+__OUT__
+
+test_oE 'temporary appending assignment'
+a=A
+a+=B sh -c 'echo $a'
+echo $a
+__IN__
+AB
+A
+__OUT__
+
+test_oE 'appending assignment is not recognized in POSIXly-correct mode' \
+    --posix
+a=1
+a+=2 2>/dev/null || echo error
+echo $a
+__IN__
+error
+1
+__OUT__
+
 test_O -d 'redirections do not apply to assignments w/o command name'
 readonly x=x
 x=y 2>/dev/null
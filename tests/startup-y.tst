@@ -424,10 +424,12 @@ Options:
 	         -o forlocal
 	+f       -o glob
 	-h       -o hashondef
+	         -o histbinary
 	         -o histspace
 	         -o ignoreeof
 	-i       -o interactive
 	         -o lealwaysrp
+	         -o lecompcancel
 	         -o lecompdebug
 	         -o leconvmeta
 	         -o lenoconvmeta
@@ -443,6 +445,7 @@ Options:
 	-b       -o notify
 	         -o notifyle
 	         -o nullglob
+	         -o parallelglob
 	         -o pipefail
 	         -o posixlycorrect
 	-s       -o stdin
@@ -483,10 +486,12 @@ Options:
 	         -o forlocal
 	+f       -o glob
 	-h       -o hashondef
+	         -o histbinary
 	         -o histspace
 	         -o ignoreeof
 	-i       -o interactive
 	         -o lealwaysrp
+	         -o lecompcancel
 	         -o lecompdebug
 	         -o leconvmeta
 	         -o lenoconvmeta
@@ -502,6 +507,7 @@ Options:
 	-b       -o notify
 	         -o notifyle
 	         -o nullglob
+	         -o parallelglob
 	         -o pipefail
 	         -o posixlycorrect
 	-s       -o stdin
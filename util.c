@@ -25,6 +25,7 @@
 # include <libintl.h>
 #endif
 #include <limits.h>
+#include <locale.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -221,6 +222,120 @@ void *copyaswcs(const void *p)
     return xwcsdup(p);
 }
 
+/* Sort key of an element in `collsort' */
+struct collkey_T {
+    const wchar_t *key;
+    wchar_t *xfrmkey;
+    const char *elem;
+};
+/* `key' is the string compared in sorting, which is `xfrmkey' if the string
+ * has been transformed by `wcsxfrm'. */
+
+static bool is_simple_collation(void);
+static wchar_t *malloc_wcsxfrm(const wchar_t *s)
+    __attribute__((malloc,warn_unused_result,nonnull));
+static void sort_collkeys(struct collkey_T *keys, size_t count, size_t depth)
+    __attribute__((nonnull));
+
+/* Sorts `count' elements of `size' bytes in array `base' in the collating order
+ * of the wide strings that function `keyof' returns for (pointers to) the
+ * elements. The result is the same as that of `qsort' with a comparison
+ * function that applies `wcscoll' to the keys, but each key is transformed by
+ * `wcsxfrm' only once instead of being analyzed in every comparison. In the C
+ * locale, the keys are compared without transformation. */
+void collsort(void *base, size_t count, size_t size,
+        const wchar_t *keyof(const void *elem))
+{
+    if (count < 2)
+        return;
+
+    bool simple = is_simple_collation();
+    struct collkey_T *keys = xmallocn(count, sizeof *keys);
+    for (size_t i = 0; i < count; i++) {
+        keys[i].elem = (const char *) base + i * size;
+        keys[i].key = keyof(keys[i].elem);
+        if (simple) {
+            keys[i].xfrmkey = NULL;
+        } else {
+            keys[i].xfrmkey = malloc_wcsxfrm(keys[i].key);
+            keys[i].key = keys[i].xfrmkey;
+        }
+    }
+
+    sort_collkeys(keys, count, 0);
+
+    char *sorted = xmallocn(count, size);
+    for (size_t i = 0; i < count; i++) {
+        memcpy(&sorted[i * size], keys[i].elem, size);
+        free(keys[i].xfrmkey);
+    }
+    memcpy(base, sorted, count * size);
+    free(sorted);
+    free(keys);
+}
+
+/* Returns true iff the current locale collates strings in the order of the
+ * character values, in which case `wcscoll' is equivalent to `wcscmp'. */
+bool is_simple_collation(void)
+{
+    const char *locale = setlocale(LC_COLLATE, NULL);
+    return locale == NULL
+        || strcmp(locale, "C") == 0 || strcmp(locale, "POSIX") == 0;
+}
+
+/* Returns a newly-malloced string that is the result of `wcsxfrm' for `s'. */
+wchar_t *malloc_wcsxfrm(const wchar_t *s)
+{
+    size_t length = wcsxfrm(NULL, s, 0);
+    if (length == (size_t) -1)
+        return xwcsdup(s);
+
+    wchar_t *result = xmallocn(add(length, 1), sizeof *result);
+    wcsxfrm(result, s, length + 1);
+    return result;
+}
+
+/* Sorts `keys' by the strings `keys[i].key', assuming the first `depth'
+ * characters are the same for all the keys.
+ * This is a multikey quicksort, which partitions the keys into three groups by
+ * the character at `depth' so that the common prefix of the keys is never
+ * compared again. */
+void sort_collkeys(struct collkey_T *keys, size_t count, size_t depth)
+{
+    while (count > 1) {
+        wchar_t pivot = keys[count / 2].key[depth];
+        size_t lt = 0, i = 0, gt = count;
+        while (i < gt) {
+            wchar_t c = keys[i].key[depth];
+            struct collkey_T temp;
+            if (c < pivot) {
+                temp = keys[lt], keys[lt] = keys[i], keys[i] = temp;
+                lt++, i++;
+            } else if (c > pivot) {
+                gt--;
+                temp = keys[gt], keys[gt] = keys[i], keys[i] = temp;
+            } else {
+                i++;
+            }
+        }
+        /* Now keys[0..lt-1] < pivot, keys[lt..gt-1] == pivot, and
+         * keys[gt..count-1] > pivot at `depth'. */
+        sort_collkeys(keys, lt, depth);
+        sort_collkeys(&keys[gt], count - gt, depth);
+        if (pivot == L'\0')
+            return;
+        keys = &keys[lt], count = gt - lt, depth++;
+    }
+}
+
+/* Returns the wide string pointed to by `elem', which must be a pointer to
+ * (const wchar_t *). This function can be used as the `keyof' argument to
+ * `collsort'. */
+const wchar_t *wcskeyof(const void *elem)
+{
+    return *(const wchar_t *const *) elem;
+}
+
 
 /********** Error Utilities **********/
 
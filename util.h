@@ -209,6 +209,11 @@ extern wchar_t *matchwcsprefix(const wchar_t *s, const wchar_t *prefix)
     __attribute__((pure,nonnull));
 extern void *copyaswcs(const void *p)
     __attribute__((malloc,warn_unused_result,nonnull));
+extern void collsort(void *base, size_t count, size_t size,
+        const wchar_t *keyof(const void *elem))
+    __attribute__((nonnull));
+extern const wchar_t *wcskeyof(const void *elem)
+    __attribute__((pure,nonnull));
 
 #if HAVE_STRNLEN
 # ifndef strnlen
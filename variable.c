@@ -102,20 +102,46 @@ typedef enum vartype_T {
 typedef struct variable_T {
     vartype_T v_type;
     union {
-        wchar_t *value;
+        struct {
+            wchar_t *value;
+            size_t len;
+            size_t cap;
+        } scalar;
         struct {
             void **vals;
             size_t valc;
+            size_t valoff;
+            size_t valmax;
         } array;
     } v_contents;
+    char *v_mbvalue;
     void (*v_getter)(struct variable_T *var);
 } variable_T;
-#define v_value v_contents.value
-#define v_vals  v_contents.array.vals
-#define v_valc  v_contents.array.valc
+#define v_value  v_contents.scalar.value
+#define v_vallen v_contents.scalar.len
+#define v_valcap v_contents.scalar.cap
+#define v_vals   v_contents.array.vals
+#define v_valc   v_contents.array.valc
+#define v_valoff v_contents.array.valoff
+#define v_valmax v_contents.array.valmax
 /* `v_vals' is a NULL-terminated array of pointers to wide strings.
  * `v_valc' is, of course, the number of elements in `v_vals'.
- * `v_value', `v_vals' and the elements of `v_vals' are `free'able.
+ * `v_valoff' is the number of elements that have been removed from the head of
+ * the array by the shift built-in without reallocating it: the array is
+ * actually allocated at `v_vals - v_valoff'. Use `array_rewind' before
+ * passing `v_vals' to a function that may reallocate it.
+ * `v_valmax' is the number of pointers the array allocated at
+ * `v_vals - v_valoff' can contain (including the terminating NULL).
+ * `v_valcap' is the number of wide characters that can be stored in the memory
+ * `v_value' points to (including the terminating null character), and
+ * `v_vallen' is the length of `v_value'. They are used to append to the value
+ * in place and are valid only if `v_valcap' is non-zero. Whenever `v_value' is
+ * replaced, `v_valcap' must be reset to zero.
+ * `v_mbvalue' caches the multibyte representation of the value that is
+ * exported to the environment (the elements of an array are joined with
+ * colons). It is NULL if not yet computed. Whenever the value of the variable
+ * is modified, `varmbvaluefree' must be called to invalidate the cache.
+ * `v_value', `v_vals - v_valoff' and the elements of `v_vals' are `free'able.
  * `v_value' is NULL if the variable is declared but not yet assigned.
  * `v_vals' is always non-NULL, but it may contain no elements.
  * `v_getter' is the setter function, which is reset to NULL on reassignment.*/
@@ -126,16 +152,39 @@ typedef struct function_T function_T;
 
 static void varvaluefree(variable_T *v)
     __attribute__((nonnull));
+static void varmbvaluefree(variable_T *v)
+    __attribute__((nonnull));
+static void clear_all_mbvalues(void);
+static void array_rewind(variable_T *v)
+    __attribute__((nonnull));
+static void array_reserve(variable_T *v, size_t count)
+    __attribute__((nonnull));
 static void varfree(variable_T *v);
 static void varkvfree(kvpair_T kv);
 static void varkvfree_reexport(kvpair_T kv);
 
+static hashval_T hashenvname(const void *s)
+    __attribute__((pure));
+static int htenvnamecmp(const void *s1, const void *s2)
+    __attribute__((pure));
+static variable_T *import_environ_entry(const char *entry)
+    __attribute__((nonnull));
+static variable_T *import_environment_variable(const wchar_t *name)
+    __attribute__((nonnull));
+static void import_all_environment_variables(void);
+static variable_T *lookup_variable(environ_T *env, const wchar_t *name)
+    __attribute__((nonnull));
+
 static void init_pwd(void);
 
 static variable_T *search_variable(const wchar_t *name)
     __attribute__((pure,nonnull));
 static variable_T *search_array_and_check_if_changeable(const wchar_t *name)
     __attribute__((pure,nonnull));
+static variable_T *search_exported_variable(const wchar_t *name)
+    __attribute__((pure,nonnull));
+static const char *get_mbvalue(variable_T *var)
+    __attribute__((nonnull));
 static void update_environment(const wchar_t *name)
     __attribute__((nonnull));
 static void reset_locale(const wchar_t *name)
@@ -150,9 +199,19 @@ static variable_T *new_temporary(const wchar_t *name)
     __attribute__((nonnull));
 static variable_T *new_variable(const wchar_t *name, scope_T scope)
     __attribute__((nonnull));
-static void xtrace_variable(const wchar_t *name, const wchar_t *value)
+static variable_T *search_assignee(const wchar_t *name, scope_T scope)
+    __attribute__((pure,nonnull));
+static bool append_variable(
+        const wchar_t *name, wchar_t *value, scope_T scope, bool export)
+    __attribute__((nonnull(1)));
+static bool append_array(const wchar_t *name, size_t count, void **values,
+        scope_T scope, bool export)
     __attribute__((nonnull));
-static void xtrace_array(const wchar_t *name, void *const *values)
+static void xtrace_variable(
+        const wchar_t *name, const wchar_t *value, bool append)
+    __attribute__((nonnull));
+static void xtrace_array(
+        const wchar_t *name, void *const *values, bool append)
     __attribute__((nonnull));
 static size_t make_array_of_all_variables(bool global, kvpair_T **resultp)
     __attribute__((nonnull));
@@ -190,6 +249,17 @@ static environ_T *current_env;
 /* the top-level environment (the farthest from the current) */
 static environ_T *first_env;
 
+/* hashtable of the environment variables that have not yet been imported to
+ * the top-level environment. The keys and values are the same strings in
+ * `environ', which have the form "name=value". The hash function and the
+ * comparison function only consider the name part before the first '='.
+ * Environment variables are imported lazily when they are first looked up so
+ * that the shell does not have to convert all of them at startup.
+ * The strings are those passed to the shell on startup, which remain valid
+ * because the shell never modifies `environ' for a variable that has not been
+ * imported. */
+static hashtable_T unimported_environ;
+
 /* whether $RANDOM is functioning as a random number */
 static bool random_active;
 
@@ -198,19 +268,78 @@ static hashtable_T functions;
 
 
 /* Frees the value of the specified variable (but not the variable itself). */
-/* This function does not change the value of `*v'. */
+/* This function does not change the value of `*v' except `v_mbvalue'. */
 void varvaluefree(variable_T *v)
 {
+    varmbvaluefree(v);
     switch (v->v_type & VF_MASK) {
         case VF_SCALAR:
             free(v->v_value);
             break;
         case VF_ARRAY:
-            plfree(v->v_vals, free);
+            for (size_t i = 0; i < v->v_valc; i++)
+                free(v->v_vals[i]);
+            free(v->v_vals - v->v_valoff);
             break;
     }
 }
 
+/* Moves the elements of the specified array variable to the head of the
+ * allocated array so that `v_vals' can be reallocated or freed directly.
+ * After this function returns, `v_valoff' is zero. */
+void array_rewind(variable_T *v)
+{
+    assert((v->v_type & VF_MASK) == VF_ARRAY);
+    if (v->v_valoff > 0) {
+        void **base = v->v_vals - v->v_valoff;
+        memmove(base, v->v_vals, (v->v_valc + 1) * sizeof *base);
+        v->v_vals = base;
+        v->v_valoff = 0;
+    }
+}
+
+/* Makes sure the specified array variable can contain `count' more elements
+ * without reallocation. The array may be rewound or reallocated.
+ * The capacity is increased geometrically so that appending elements one by
+ * one takes amortized constant time per element. */
+void array_reserve(variable_T *v, size_t count)
+{
+    assert((v->v_type & VF_MASK) == VF_ARRAY);
+    size_t need = add(add(v->v_valc, count), 1);
+    if (need <= v->v_valmax - v->v_valoff)
+        return;
+    array_rewind(v);
+    if (need <= v->v_valmax)
+        return;
+
+    size_t newmax = v->v_valmax * 2;
+    if (newmax < need || newmax / 2 != v->v_valmax)
+        newmax = need;
+    v->v_vals = xreallocn(v->v_vals, newmax, sizeof *v->v_vals);
+    v->v_valmax = newmax;
+}
+
+/* Frees the cached multibyte representation of the value of the specified
+ * variable. This function must be called whenever the value is modified. */
+void varmbvaluefree(variable_T *v)
+{
+    free(v->v_mbvalue);
+    v->v_mbvalue = NULL;
+}
+
+/* Invalidates the cached multibyte representations of all variables.
+ * This function must be called when the locale for character conversion
+ * changes. */
+void clear_all_mbvalues(void)
+{
+    for (environ_T *env = current_env; env != NULL; env = env->parent) {
+        size_t i = 0;
+        kvpair_T kv;
+        while ((kv = ht_next(&env->contents, &i)).key != NULL)
+            varmbvaluefree(kv.value);
+    }
+}
+
 /* Frees the specified variable. */
 void varfree(variable_T *v)
 {
@@ -255,29 +384,117 @@ void init_environment(void)
 
     ht_init(&functions, hashwcs, htwcscmp);
 
-    /* add all the existing environment variables to the variable environment */
-    for (char **e = environ; *e != NULL; e++) {
-        wchar_t *we = malloc_mbstowcs(*e);
-        if (we == NULL)
-            continue;
-
-        wchar_t *eqp = wcschr(we, L'=');
-        variable_T *v = xmalloc(sizeof *v);
-        v->v_type = VF_SCALAR | VF_EXPORT;
-        v->v_value = (eqp != NULL) ? xwcsdup(&eqp[1]) : NULL;
-        v->v_getter = NULL;
-        if (eqp != NULL) {
-            *eqp = L'\0';
-            we = xreallocn(we, eqp - we + 1, sizeof *we);
-        }
-        varkvfree(ht_set(&current_env->contents, we, v));
-    }
+    /* remember all the existing environment variables, which are added to the
+     * variable environment when used */
+    ht_init(&unimported_environ, hashenvname, htenvnamecmp);
+    for (char **e = environ; *e != NULL; e++)
+        ht_set(&unimported_environ, *e, *e);
 
     /* initialize path according to $PATH etc. */
     for (size_t i = 0; i < PA_count; i++)
         current_env->paths[i] = decompose_paths(getvar(path_variables[i]));
 }
 
+/* A hash function for the name part of an environment string.
+ * The argument is a pointer to a multibyte string (const char *) of the form
+ * "name=value" or "name". Only the part before the first '=' is hashed. */
+hashval_T hashenvname(const void *s)
+{
+    /* FNV hash, the same as `hashstr' */
+    const unsigned char *c = s;
+    hashval_T h = 0;
+    while (*c != '\0' && *c != '=')
+        h = (h ^ (hashval_T) *c++) * FNVPRIME;
+    return h;
+}
+
+/* A comparison function for the name parts of environment strings.
+ * The arguments are multibyte strings (const char *) of the form "name=value"
+ * or "name". Returns zero iff the name parts are the same. */
+int htenvnamecmp(const void *s1, const void *s2)
+{
+    const char *c1 = s1, *c2 = s2;
+    for (;;) {
+        bool end1 = (*c1 == '\0' || *c1 == '='),
+             end2 = (*c2 == '\0' || *c2 == '=');
+        if (end1 || end2)
+            return end1 && end2 ? 0 : end1 ? -1 : 1;
+        if (*c1 != *c2)
+            return (unsigned char) *c1 - (unsigned char) *c2;
+        c1++, c2++;
+    }
+}
+
+/* Converts the specified environment string of the form "name=value" into a
+ * variable and adds it to the top-level environment.
+ * Returns the new variable, or NULL if the string cannot be converted to a
+ * wide string. */
+variable_T *import_environ_entry(const char *entry)
+{
+    wchar_t *we = malloc_mbstowcs(entry);
+    if (we == NULL)
+        return NULL;
+
+    wchar_t *eqp = wcschr(we, L'=');
+    const char *mbeqp = strchr(entry, '=');
+    variable_T *v = xmalloc(sizeof *v);
+    v->v_type = VF_SCALAR | VF_EXPORT;
+    v->v_value = (eqp != NULL) ? xwcsdup(&eqp[1]) : NULL;
+    v->v_valcap = 0;
+    v->v_mbvalue = (eqp != NULL && mbeqp != NULL) ? xstrdup(&mbeqp[1]) : NULL;
+    v->v_getter = NULL;
+    if (eqp != NULL) {
+        *eqp = L'\0';
+        we = xreallocn(we, eqp - we + 1, sizeof *we);
+    }
+    varkvfree(ht_set(&first_env->contents, we, v));
+    return v;
+}
+
+/* If there is an environment variable with the specified name that has not
+ * yet been imported, imports and returns it. Otherwise, returns NULL. */
+variable_T *import_environment_variable(const wchar_t *name)
+{
+    if (unimported_environ.count == 0 || wcschr(name, L'=') != NULL)
+        return NULL;
+
+    char *mbsname = malloc_wcstombs(name);
+    if (mbsname == NULL)
+        return NULL;
+
+    kvpair_T kv = ht_remove(&unimported_environ, mbsname);
+    free(mbsname);
+    if (kv.key == NULL)
+        return NULL;
+    return import_environ_entry(kv.value);
+}
+
+/* Imports all the environment variables that have not yet been imported.
+ * This function must be called before iterating over the variables in the
+ * top-level environment. */
+void import_all_environment_variables(void)
+{
+    if (unimported_environ.count == 0)
+        return;
+
+    size_t i = 0;
+    kvpair_T kv;
+    while ((kv = ht_next(&unimported_environ, &i)).key != NULL)
+        import_environ_entry(kv.value);
+    ht_clear(&unimported_environ, NULL);
+}
+
+/* Returns the variable with the specified name in the specified environment,
+ * or NULL if there is none. If `env' is the top-level environment, the
+ * variable is imported from the environment variables if necessary. */
+variable_T *lookup_variable(environ_T *env, const wchar_t *name)
+{
+    variable_T *var = ht_get(&env->contents, name).value;
+    if (var == NULL && env == first_env)
+        var = import_environment_variable(name);
+    return var;
+}
+
 /* Initializes the default variables.
  * This function must be called after the shell options have been set. */
 void init_variables(void)
@@ -291,6 +508,7 @@ void init_variables(void)
         assert(v != NULL);
         v->v_type = VF_SCALAR | (v->v_type & VF_EXPORT);
         v->v_value = NULL;
+        v->v_valcap = 0;
         v->v_getter = lineno_getter;
         // variable_set(VAR_LINENO, v);
         // if (v->v_type & VF_EXPORT)
@@ -333,6 +551,7 @@ void init_variables(void)
         assert(v != NULL);
         v->v_type = VF_SCALAR;
         v->v_value = NULL;
+        v->v_valcap = 0;
         v->v_getter = random_getter;
         random_active = true;
         srand((unsigned) time(NULL) ^ (unsigned) shell_pid << 17);
@@ -386,7 +605,7 @@ set:
 variable_T *search_variable(const wchar_t *name)
 {
     for (environ_T *env = current_env; env != NULL; env = env->parent) {
-        variable_T *var = ht_get(&env->contents, name).value;
+        variable_T *var = lookup_variable(env, name);
         if (var != NULL)
             return var;
     }
@@ -408,6 +627,45 @@ variable_T *search_array_and_check_if_changeable(const wchar_t *name)
     return array;
 }
 
+/* Searches for an exported variable that has a value with the specified name.
+ * Returns NULL if none was found. */
+variable_T *search_exported_variable(const wchar_t *name)
+{
+    for (environ_T *env = current_env; env != NULL; env = env->parent) {
+        variable_T *var = lookup_variable(env, name);
+        if (var != NULL && (var->v_type & VF_EXPORT)) {
+            if ((var->v_type & VF_MASK) == VF_SCALAR && var->v_value == NULL)
+                continue;
+            return var;
+        }
+    }
+    return NULL;
+}
+
+/* Returns the multibyte representation of the value of the specified variable
+ * that should be exported. The result is cached in the variable so that the
+ * value is not converted again until it is modified. If the variable value
+ * cannot be converted to a multibyte string, NULL is returned. The result must
+ * not be modified or freed by the caller. */
+const char *get_mbvalue(variable_T *var)
+{
+    if (var->v_mbvalue == NULL) {
+        switch (var->v_type & VF_MASK) {
+            case VF_SCALAR:
+                assert(var->v_value != NULL);
+                var->v_mbvalue = malloc_wcstombs(var->v_value);
+                break;
+            case VF_ARRAY:
+                var->v_mbvalue =
+                    realloc_wcstombs(joinwcsarray(var->v_vals, L":"));
+                break;
+            default:
+                assert(false);
+        }
+    }
+    return var->v_mbvalue;
+}
+
 /* Update the value in `environ' for the variable with the specified name.
  * `name' must not contain '='. */
 void update_environment(const wchar_t *name)
@@ -416,7 +674,8 @@ void update_environment(const wchar_t *name)
     if (mname == NULL)
         return;
 
-    char *value = get_exported_value(name);
+    variable_T *var = search_exported_variable(name);
+    const char *value = (var != NULL) ? get_mbvalue(var) : NULL;
     if (value == NULL) {
         if (xunsetenv(mname) < 0)
             xerror(errno, Ngt("failed to unset environment variable $%s"),
@@ -427,7 +686,6 @@ void update_environment(const wchar_t *name)
     }
 
     free(mname);
-    free(value);
 }
 
 /* Returns the value of variable `name' that should be exported.
@@ -435,22 +693,12 @@ void update_environment(const wchar_t *name)
  * a multibyte string, NULL is returned. */
 char *get_exported_value(const wchar_t *name)
 {
-    for (environ_T *env = current_env; env != NULL; env = env->parent) {
-        const variable_T *var = ht_get(&env->contents, name).value;
-        if (var != NULL && (var->v_type & VF_EXPORT)) {
-            switch (var->v_type & VF_MASK) {
-                case VF_SCALAR:
-                    if (var->v_value == NULL)
-                        continue;
-                    return malloc_wcstombs(var->v_value);
-                case VF_ARRAY:
-                    return realloc_wcstombs(joinwcsarray(var->v_vals, L":"));
-                default:
-                    assert(false);
-            }
-        }
-    }
-    return NULL;
+    variable_T *var = search_exported_variable(name);
+    if (var == NULL)
+        return NULL;
+
+    const char *value = get_mbvalue(var);
+    return (value != NULL) ? xstrdup(value) : NULL;
 }
 
 /* Resets the locate settings for the specified variable.
@@ -504,7 +752,12 @@ void reset_locale_category(const wchar_t *name, int category)
     }
     char *wlocale = malloc_wcstombs(locale);
     if (wlocale != NULL) {
-        setlocale(category, wlocale);
+        /* Environment variables must be converted in the locale in which the
+         * shell was started. */
+        if (category == LC_CTYPE)
+            import_all_environment_variables();
+        if (setlocale(category, wlocale) != NULL && category == LC_CTYPE)
+            clear_all_mbvalues();
         free(wlocale);
     }
 }
@@ -517,7 +770,7 @@ variable_T *new_global(const wchar_t *name)
 {
     variable_T *var;
     for (environ_T *env = current_env; env != NULL; env = env->parent) {
-        var = ht_get(&env->contents, name).value;
+        var = lookup_variable(env, name);
         if (var != NULL) {
             if (env->is_temporary) {
                 assert(!(var->v_type & VF_NODELETE));
@@ -528,8 +781,10 @@ variable_T *new_global(const wchar_t *name)
         }
     }
     var = xmalloc(sizeof *var);
+    var->v_mbvalue = NULL;
     var->v_type = VF_SCALAR;
     var->v_value = NULL;
+    var->v_valcap = 0;
     var->v_getter = NULL;
     ht_set(&first_env->contents, xwcsdup(name), var);
     return var;
@@ -546,12 +801,14 @@ variable_T *new_local(const wchar_t *name)
         varkvfree_reexport(ht_remove(&env->contents, name));
         env = env->parent;
     }
-    variable_T *var = ht_get(&env->contents, name).value;
+    variable_T *var = lookup_variable(env, name);
     if (var != NULL)
         return var;
     var = xmalloc(sizeof *var);
+    var->v_mbvalue = NULL;
     var->v_type = VF_SCALAR;
     var->v_value = NULL;
+    var->v_valcap = 0;
     var->v_getter = NULL;
     ht_set(&env->contents, xwcsdup(name), var);
     return var;
@@ -573,12 +830,14 @@ variable_T *new_temporary(const wchar_t *name)
     if (var != NULL && (var->v_type & VF_READONLY))
         return var;
 
-    var = ht_get(&env->contents, name).value;
+    var = lookup_variable(env, name);
     if (var != NULL)
         return var;
     var = xmalloc(sizeof *var);
+    var->v_mbvalue = NULL;
     var->v_type = VF_SCALAR;
     var->v_value = NULL;
+    var->v_valcap = 0;
     var->v_getter = NULL;
     ht_set(&env->contents, xwcsdup(name), var);
     return var;
@@ -637,6 +896,7 @@ bool set_variable(
         | (var->v_type & (VF_EXPORT | VF_NODELETE))
         | (export ? VF_EXPORT : 0);
     var->v_value = value;
+    var->v_valcap = 0;
     var->v_getter = NULL;
 
     variable_set(name, var);
@@ -675,6 +935,8 @@ variable_T *set_array(const wchar_t *name, size_t count, void **values,
         | (export ? VF_EXPORT : 0);
     var->v_vals = values;
     var->v_valc = (count != 0) ? count : plcount(var->v_vals);
+    var->v_valoff = 0;
+    var->v_valmax = var->v_valc + 1;
     var->v_getter = NULL;
 
     variable_set(name, var);
@@ -700,6 +962,7 @@ bool set_array_element(const wchar_t *name, size_t index, wchar_t *value)
 
     free(array->v_vals[index]);
     array->v_vals[index] = value;
+    varmbvaluefree(array);
     if (array->v_type & VF_EXPORT)
         update_environment(name);
     return true;
@@ -754,8 +1017,9 @@ bool do_assignments(const assign_T *assign, bool temp, bool export)
                 if (value == NULL)
                     return false;
                 if (shopt_xtrace)
-                    xtrace_variable(assign->a_name, value);
-                if (!set_variable(assign->a_name, value, scope, export))
+                    xtrace_variable(assign->a_name, value, assign->a_append);
+                if (!(assign->a_append ? append_variable : set_variable)(
+                            assign->a_name, value, scope, export))
                     return false;
                 break;
             case A_ARRAY:
@@ -763,9 +1027,16 @@ bool do_assignments(const assign_T *assign, bool temp, bool export)
                     return false;
                 assert(values != NULL);
                 if (shopt_xtrace)
-                    xtrace_array(assign->a_name, values);
-                if (!set_array(assign->a_name, count, values, scope, export))
-                    return false;
+                    xtrace_array(assign->a_name, values, assign->a_append);
+                if (assign->a_append) {
+                    if (!append_array(
+                                assign->a_name, count, values, scope, export))
+                        return false;
+                } else {
+                    if (!set_array(
+                                assign->a_name, count, values, scope, export))
+                        return false;
+                }
                 break;
         }
         assign = assign->next;
@@ -773,22 +1044,181 @@ bool do_assignments(const assign_T *assign, bool temp, bool export)
     return true;
 }
 
+/* Returns the existing variable that would be modified in place by an
+ * assignment in the specified scope, or NULL if the assignment would create a
+ * new variable or the visible variable is a temporary variable that the
+ * assignment would remove. */
+variable_T *search_assignee(const wchar_t *name, scope_T scope)
+{
+    environ_T *env = current_env;
+    variable_T *var;
+
+    switch (scope) {
+        case SCOPE_GLOBAL:
+            for (; env != NULL; env = env->parent) {
+                var = lookup_variable(env, name);
+                if (var != NULL)
+                    return env->is_temporary ? NULL : var;
+            }
+            return NULL;
+        case SCOPE_LOCAL:
+            for (; env->is_temporary; env = env->parent)
+                if (lookup_variable(env, name) != NULL)
+                    return NULL;
+            return lookup_variable(env, name);
+        case SCOPE_TEMP:
+            return lookup_variable(env, name);
+    }
+    assert(false);
+}
+
+/* Appends `value' to the value of the specified scalar variable.
+ * The arguments are the same as those of `set_variable'.
+ * If the variable is an array, `value' is appended as a new element.
+ * If the variable has a value that can be modified in place, the value is
+ * extended without copying the existing value. The capacity of the value is
+ * increased geometrically so that repeated appending takes amortized time
+ * proportional to the length of the appended value.
+ * Otherwise, the concatenation of the current value and `value' is assigned
+ * by `set_variable'. */
+bool append_variable(
+        const wchar_t *name, wchar_t *value, scope_T scope, bool export)
+{
+    if (value == NULL)
+        value = xwcsdup(L"");
+
+    variable_T *var = search_assignee(name, scope);
+    if (var != NULL && (var->v_type & VF_MASK) == VF_ARRAY &&
+            var->v_getter == NULL) {
+        void **values = xmallocn(2, sizeof *values);
+        values[0] = value;
+        values[1] = NULL;
+        return append_array(name, 1, values, scope, export);
+    }
+    if (var == NULL || var->v_value == NULL || var->v_getter != NULL ||
+            (var->v_type & VF_READONLY)) {
+        /* fall back to normal assignment */
+        const wchar_t *oldvalue = NULL;
+        var = search_variable(name);
+        if (var != NULL && (var->v_type & VF_MASK) == VF_SCALAR) {
+            if (var->v_getter != NULL)
+                var->v_getter(var);
+            if ((var->v_type & VF_MASK) == VF_SCALAR)
+                oldvalue = var->v_value;
+        }
+        if (oldvalue != NULL) {
+            wchar_t *newvalue = malloc_wprintf(L"%ls%ls", oldvalue, value);
+            free(value);
+            value = newvalue;
+        }
+        return set_variable(name, value, scope, export);
+    }
+
+    assert((var->v_type & VF_MASK) == VF_SCALAR);
+    if (shopt_allexport && name[0] != '=')
+        export = true;
+
+    if (var->v_valcap == 0) {
+        var->v_vallen = wcslen(var->v_value);
+        var->v_valcap = var->v_vallen + 1;
+    }
+    size_t addlen = wcslen(value);
+    size_t need = add(add(var->v_vallen, addlen), 1);
+    if (need > var->v_valcap) {
+        size_t newcap = var->v_valcap * 2;
+        if (newcap < need || newcap / 2 != var->v_valcap)
+            newcap = need;
+        var->v_value = xreallocn(var->v_value, newcap, sizeof *var->v_value);
+        var->v_valcap = newcap;
+    }
+    wmemcpy(&var->v_value[var->v_vallen], value, addlen + 1);
+    var->v_vallen += addlen;
+    varmbvaluefree(var);
+    free(value);
+
+    if (export)
+        var->v_type |= VF_EXPORT;
+    variable_set(name, var);
+    if (var->v_type & VF_EXPORT)
+        update_environment(name);
+    return true;
+}
+
+/* Appends `values' to the elements of the specified array variable.
+ * The arguments are the same as those of `set_array'.
+ * If the variable is a scalar variable that has a value, the value becomes the
+ * first element of the resultant array.
+ * If the variable is an array that can be modified in place, the elements are
+ * appended without copying the existing elements. */
+bool append_array(const wchar_t *name, size_t count, void **values,
+        scope_T scope, bool export)
+{
+    if (count == 0)
+        count = plcount(values);
+
+    variable_T *var = search_assignee(name, scope);
+    if (var == NULL || (var->v_type & VF_MASK) != VF_ARRAY ||
+            var->v_getter != NULL || (var->v_type & VF_READONLY)) {
+        /* fall back to normal assignment */
+        plist_T list;
+        pl_initwithmax(&list, add(count, 2));
+        var = search_variable(name);
+        if (var != NULL) {
+            if (var->v_getter != NULL)
+                var->v_getter(var);
+            switch (var->v_type & VF_MASK) {
+                case VF_SCALAR:
+                    if (var->v_value != NULL)
+                        pl_add(&list, xwcsdup(var->v_value));
+                    break;
+                case VF_ARRAY:
+                    for (size_t i = 0; i < var->v_valc; i++)
+                        pl_add(&list, xwcsdup(var->v_vals[i]));
+                    break;
+            }
+        }
+        pl_cat(&list, values);
+        free(values);
+        count = list.length;
+        return set_array(name, count, pl_toary(&list), scope, export) != NULL;
+    }
+
+    if (shopt_allexport && name[0] != '=')
+        export = true;
+
+    array_reserve(var, count);
+    memcpy(&var->v_vals[var->v_valc], values, count * sizeof *values);
+    var->v_valc += count;
+    var->v_vals[var->v_valc] = NULL;
+    varmbvaluefree(var);
+    free(values);
+
+    if (export)
+        var->v_type |= VF_EXPORT;
+    variable_set(name, var);
+    if (var->v_type & VF_EXPORT)
+        update_environment(name);
+    return true;
+}
+
 /* Pushes a trace of the specified variable assignment to the xtrace buffer. */
-void xtrace_variable(const wchar_t *name, const wchar_t *value)
+void xtrace_variable(const wchar_t *name, const wchar_t *value, bool append)
 {
     xwcsbuf_T *buf = get_xtrace_buffer();
     wb_wccat(buf, L' ');
     wb_cat(buf, name);
+    if (append)
+        wb_wccat(buf, L'+');
     wb_wccat(buf, L'=');
     wb_quote_as_word(buf, value);
 }
 
 /* Pushes a trace of the specified array assignment to the xtrace buffer. */
-void xtrace_array(const wchar_t *name, void *const *values)
+void xtrace_array(const wchar_t *name, void *const *values, bool append)
 {
     xwcsbuf_T *buf = get_xtrace_buffer();
 
-    wb_wprintf(buf, L" %ls=(", name);
+    wb_wprintf(buf, L" %ls%ls=(", name, append ? L"+" : L"");
     if (*values != NULL) {
         for (;;) {
             wb_quote_as_word(buf, *values);
@@ -951,6 +1381,8 @@ void save_get_variable_values(struct get_variable_T *gv)
 size_t make_array_of_all_variables(bool global, kvpair_T **resultp)
 {
     if (current_env->parent == NULL || (!global && current_env->is_temporary)) {
+        if (current_env == first_env)
+            import_all_environment_variables();
         *resultp = ht_tokvarray(&current_env->contents);
         return current_env->contents.count;
     } else {
@@ -974,6 +1406,9 @@ size_t make_array_of_all_variables(bool global, kvpair_T **resultp)
  * caller. */
 void get_all_variables_rec(hashtable_T *table, environ_T *env, bool global)
 {
+    if (env == first_env)
+        import_all_environment_variables();
+
     if (env->parent != NULL && (global || env->is_temporary))
         get_all_variables_rec(table, env->parent, global);
 
@@ -1040,7 +1475,9 @@ void lineno_getter(variable_T *var)
 {
     assert((var->v_type & VF_MASK) == VF_SCALAR);
     free(var->v_value);
+    varmbvaluefree(var);
     var->v_value = malloc_wprintf(L"%lu", current_lineno);
+    var->v_valcap = 0;
     // variable_set(VAR_LINENO, var);
     if (var->v_type & VF_EXPORT)
         update_environment(L VAR_LINENO);
@@ -1051,7 +1488,9 @@ void random_getter(variable_T *var)
 {
     assert((var->v_type & VF_MASK) == VF_SCALAR);
     free(var->v_value);
+    varmbvaluefree(var);
     var->v_value = malloc_wprintf(L"%u", next_random());
+    var->v_valcap = 0;
     // variable_set(VAR_RANDOM, var);
     if (var->v_type & VF_EXPORT)
         update_environment(L VAR_RANDOM);
@@ -1126,6 +1565,8 @@ void variable_set(const wchar_t *name, variable_T *var)
     case L'Y':
         if (wcscmp(name, L VAR_YASH_LOADPATH) == 0)
             reset_path(PA_LOADPATH, var);
+        else if (wcscmp(name, L VAR_YASH_PATH_INDEX) == 0)
+            clear_cmdindex();
         break;
     }
 }
@@ -1196,7 +1637,7 @@ void reset_path(path_T name, variable_T *var)
     for (environ_T *env = current_env; env != NULL; env = env->parent) {
         plfree((void **) env->paths[name], free);
 
-        variable_T *v = ht_get(&env->contents, path_variables[name]).value;
+        variable_T *v = lookup_variable(env, path_variables[name]);
         if (v != NULL) {
             switch (v->v_type & VF_MASK) {
                 case VF_SCALAR:
@@ -1368,6 +1809,8 @@ void generate_variable_candidates(const le_compopt_T *compopt)
     if (!le_compile_cpatterns(compopt))
         return;
 
+    import_all_environment_variables();
+
     size_t i = 0;
     kvpair_T kv;
     while ((kv = ht_next(&first_env->contents, &i)).key != NULL) {
@@ -1719,7 +2162,7 @@ int typeset_builtin(int argc, void **argv)
         if (!function) {
             /* print all variables */
             count = make_array_of_all_variables(global, &kvs);
-            qsort(kvs, count, sizeof *kvs, keywcscoll);
+            collsort(kvs, count, sizeof *kvs, kvwcskeyof);
             for (size_t i = 0; yash_error_message_count == 0 && i < count; i++)
                 print_variable(
                         kvs[i].key, kvs[i].value, ARGV(0), readonly, export);
@@ -1727,7 +2170,7 @@ int typeset_builtin(int argc, void **argv)
             /* print all functions */
             kvs = ht_tokvarray(&functions);
             count = functions.count;
-            qsort(kvs, count, sizeof *kvs, keywcscoll);
+            collsort(kvs, count, sizeof *kvs, kvwcskeyof);
             for (size_t i = 0; yash_error_message_count == 0 && i < count; i++)
                 print_function(kvs[i].key, kvs[i].value, ARGV(0), readonly);
         }
@@ -1750,6 +2193,7 @@ int typeset_builtin(int argc, void **argv)
                             varvaluefree(var);
                             var->v_type = VF_SCALAR | (var->v_type & ~VF_MASK);
                             var->v_value = xwcsdup(&wequal[1]);
+                            var->v_valcap = 0;
                             var->v_getter = NULL;
                         }
                     }
@@ -1804,8 +2248,6 @@ void print_variable(
         const wchar_t *name, const variable_T *var,
         const wchar_t *argv0, bool readonly, bool export)
 {
-    wchar_t *qname = NULL;
-
     if (name[0] == L'=')
         return;
     if (readonly && !(var->v_type & VF_READONLY))
@@ -1813,19 +2255,23 @@ void print_variable(
     if (export && !(var->v_type & VF_EXPORT))
         return;
 
-    if (!is_name(name))
-        name = qname = quote_as_word(name);
+    wchar_t array[XWCSBUF_STACKSIZE];
+    xwcsbuf_T qname;
+    bool namequote = !is_name(name);
+    wb_initwithstack(&qname, array, XWCSBUF_STACKSIZE);
+    if (namequote)
+        name = wb_quote_as_word(&qname, name)->contents;
 
     switch (var->v_type & VF_MASK) {
         case VF_SCALAR:
-            print_scalar(name, qname != NULL, var, argv0);
+            print_scalar(name, namequote, var, argv0);
             break;
         case VF_ARRAY:
             print_array(name, var, argv0);
             break;
     }
 
-    free(qname);
+    wb_destroy(&qname);
 }
 
 /* Prints the specified scalar variable to the standard output.
@@ -1836,12 +2282,15 @@ void print_variable(
 void print_scalar(const wchar_t *name, bool namequote,
         const variable_T *var, const wchar_t *argv0)
 {
-    wchar_t *quotedvalue;
+    wchar_t array[XWCSBUF_STACKSIZE];
+    xwcsbuf_T qvalue;
+    const wchar_t *quotedvalue;
     const char *format;
     char *opts;
 
+    wb_initwithstack(&qvalue, array, XWCSBUF_STACKSIZE);
     if (var->v_value != NULL)
-        quotedvalue = quote_as_word(var->v_value);
+        quotedvalue = wb_quote_as_word(&qvalue, var->v_value)->contents;
     else
         quotedvalue = NULL;
     switch (argv0[0]) {
@@ -1871,7 +2320,7 @@ typeset:
         default:
             assert(false);
     }
-    free(quotedvalue);
+    wb_destroy(&qvalue);
 }
 
 /* Prints the specified array variable to the standard output.
@@ -1882,18 +2331,25 @@ void print_array(
     if (!xprintf("%ls=(", name))
         return;
     if (var->v_valc > 0) {
+        wchar_t array[XWCSBUF_STACKSIZE];
+        xwcsbuf_T qvalue;
+        bool ok;
+        wb_initwithstack(&qvalue, array, XWCSBUF_STACKSIZE);
         for (size_t i = 0; ; ) {
-            wchar_t *qvalue = quote_as_word(var->v_vals[i]);
-            bool ok = xprintf("%ls", qvalue);
-            free(qvalue);
+            wb_quote_as_word(wb_clear(&qvalue), var->v_vals[i]);
+            ok = xprintf("%ls", qvalue.contents);
             if (!ok)
-                return;
+                break;
             i++;
             if (i >= var->v_valc)
                 break;
-            if (!xprintf(" "))
-                return;
+            ok = xprintf(" ");
+            if (!ok)
+                break;
         }
+        wb_destroy(&qvalue);
+        if (!ok)
+            return;
     }
     if (!xprintf(")\n"))
         return;
@@ -1936,12 +2392,15 @@ void print_function(
     if (readonly && !(func->f_type & VF_READONLY))
         return;
 
-    wchar_t *qname = NULL;
-    if (!is_name(name))
-        name = qname = quote_as_word(name);
+    wchar_t array[XWCSBUF_STACKSIZE];
+    xwcsbuf_T qname;
+    bool namequote = !is_name(name);
+    wb_initwithstack(&qname, array, XWCSBUF_STACKSIZE);
+    if (namequote)
+        name = wb_quote_as_word(&qname, name)->contents;
 
     wchar_t *value = command_to_wcs(func->f_body, true);
-    const char *format = (qname == NULL) ? "%ls()\n%ls" : "function %ls()\n%ls";
+    const char *format = !namequote ? "%ls()\n%ls" : "function %ls()\n%ls";
     bool ok = xprintf(format, name, value);
     free(value);
     if (!ok)
@@ -1963,7 +2422,7 @@ void print_function(
     }
 
 end:
-    free(qname);
+    wb_destroy(&qname);
 }
 
 /* Returns a newly malloced string that specifies options for the typeset
@@ -2114,7 +2573,7 @@ int array_dump_all(const wchar_t *argv0)
 {
     kvpair_T *kvs;
     size_t count = make_array_of_all_variables(true, &kvs);
-    qsort(kvs, count, sizeof *kvs, keywcscoll);
+    collsort(kvs, count, sizeof *kvs, kvwcskeyof);
     for (size_t i = 0; yash_error_message_count == 0 && i < count; i++) {
         variable_T *var = kvs[i].value;
         if ((var->v_type & VF_MASK) == VF_ARRAY)
@@ -2164,6 +2623,7 @@ void array_remove_elements(
      * affect the indices for later removals. */
     plist_T list;
     long lastindex = LONG_MIN;
+    array_rewind(array);
     pl_initwith(&list, array->v_vals, array->v_valc);
     for (size_t i = count; i-- != 0; ) {
         long index = indices[i];
@@ -2177,6 +2637,8 @@ void array_remove_elements(
     }
     array->v_valc = list.length;
     array->v_vals = pl_toary(&list);
+    array->v_valmax = array->v_valc + 1;
+    varmbvaluefree(array);
 }
 
 int compare_long(const void *lp1, const void *lp2)
@@ -2223,12 +2685,15 @@ void array_insert_elements(
         uindex = array->v_valc;
 
     plist_T list;
+    array_rewind(array);
     pl_initwith(&list, array->v_vals, array->v_valc);
     pl_insert(&list, uindex, values);
     for (size_t i = 0; i < count; i++)
         list.contents[uindex + i] = xwcsdup(list.contents[uindex + i]);
     array->v_valc = list.length;
     array->v_vals = pl_toary(&list);
+    array->v_valmax = array->v_valc + 1;
+    varmbvaluefree(array);
 }
 
 /* Sets the value of the specified element of the array.
@@ -2263,6 +2728,7 @@ void array_set_element(const wchar_t *name, variable_T *array,
     assert(uindex < array->v_valc);
     free(array->v_vals[uindex]);
     array->v_vals[uindex] = xwcsdup(value);
+    varmbvaluefree(array);
     return;
 
 invalid_index:
@@ -2361,6 +2827,8 @@ bool unset_function(const wchar_t *name)
 bool unset_variable(const wchar_t *name)
 {
     for (environ_T *env = current_env; env != NULL; env = env->parent) {
+        if (lookup_variable(env, name) == NULL)
+            continue;
         kvpair_T kv = ht_remove(&env->contents, name);
         variable_T *var = kv.value;
         if (var != NULL) {
@@ -2478,14 +2946,20 @@ int shift_builtin(int argc, void **argv)
         return Exit_FAILURE;
     }
 
+    /* Elements are removed without reallocating the array so that the
+     * operation takes time proportional to `abscount', not to the array size.
+     * Removal from the head just advances `v_vals'. */
     size_t from = (count >= 0) ? 0 : (var->v_valc - (size_t) abscount);
-    plist_T list;
-    pl_initwith(&list, var->v_vals, var->v_valc);
     for (size_t i = 0; i < (size_t) abscount; i++)
-        free(list.contents[from + i]);
-    pl_remove(&list, from, (size_t) abscount);
-    var->v_valc = list.length;
-    var->v_vals = pl_toary(&list);
+        free(var->v_vals[from + i]);
+    var->v_valc -= (size_t) abscount;
+    if (count >= 0) {
+        var->v_vals += (size_t) abscount;
+        var->v_valoff += (size_t) abscount;
+    } else {
+        var->v_vals[var->v_valc] = NULL;
+    }
+    varmbvaluefree(var);
 
     return Exit_SUCCESS;
 }
@@ -3150,10 +3624,10 @@ variable_T *get_dirstack(void)
  * modify or free `value' after calling this function. */
 void push_dirstack(variable_T *var, wchar_t *value)
 {
-    size_t index = var->v_valc++;
-    var->v_vals = xrealloce(var->v_vals, index, 2, sizeof *var->v_vals);
-    var->v_vals[index] = value;
-    var->v_vals[index + 1] = NULL;
+    array_reserve(var, 1);
+    var->v_vals[var->v_valc++] = value;
+    var->v_vals[var->v_valc] = NULL;
+    varmbvaluefree(var);
 }
 
 /* Removes the directory stack entry specified by `index'.
@@ -3166,6 +3640,7 @@ void remove_dirstack_entry_at(variable_T *var, size_t index)
     memmove(&var->v_vals[index], &var->v_vals[index + 1],
             (var->v_valc - index) * sizeof *var->v_vals);
     var->v_valc--;
+    varmbvaluefree(var);
 }
 
 /* Removes directory stack entries that are the same as the current working
@@ -3245,6 +3720,7 @@ int popd_builtin(int argc, void **argv)
     var->v_valc--;
     newpwd = var->v_vals[var->v_valc];
     var->v_vals[var->v_valc] = NULL;
+    varmbvaluefree(var);
     result = change_directory(newpwd, true, true);
     free(newpwd);
     if (var->v_type & VF_EXPORT)
@@ -70,6 +70,7 @@ extern char **environ;
 #define VAR_YASH_AFTER_CD             "YASH_AFTER_CD"
 #define VAR_YASH_LE_TIMEOUT           "YASH_LE_TIMEOUT"
 #define VAR_YASH_LOADPATH             "YASH_LOADPATH"
+#define VAR_YASH_PATH_INDEX           "YASH_PATH_INDEX"
 #define VAR_YASH_VERSION              "YASH_VERSION"
 #define L                             L""
 
@@ -174,6 +174,47 @@ bool is_pathname_matching_pattern(const wchar_t *pat)
     return is_matching_pattern(pat);
 }
 
+/* Returns the longest part of the pattern that any string matching the pattern
+ * contains literally. Backslash escapes are removed in the result. Since it is
+ * not easy to tell where a bracket expression ends, characters after a bracket
+ * are ignored.
+ * The result is a newly-malloced string, which may be empty. */
+wchar_t *get_pattern_literal(const wchar_t *pat)
+{
+    xwcsbuf_T buf;
+    size_t beststart = 0, bestlength = 0, start = 0;
+
+    wb_init(&buf);
+    for (;;) {
+        switch (*pat) {
+            case L'\\':
+                if (pat[1] != L'\0') {
+                    wb_wccat(&buf, pat[1]);
+                    pat += 2;
+                    continue;
+                }
+                /* falls thru! */
+            case L'\0':  case L'[':  case L'*':  case L'?':
+                if (buf.length - start > bestlength) {
+                    beststart = start;
+                    bestlength = buf.length - start;
+                }
+                if (*pat != L'*' && *pat != L'?')
+                    goto done;
+                start = buf.length;
+                break;
+            default:
+                wb_wccat(&buf, *pat);
+                break;
+        }
+        pat++;
+    }
+done:
+    wb_truncate(&buf, beststart + bestlength);
+    wb_remove(&buf, 0, beststart);
+    return wb_towcs(&buf);
+}
+
 /* Compiles the specified pattern.
  * The flags are logical OR of the followings:
  *  XFNM_SHORTEST:  do shortest match
@@ -40,6 +40,8 @@ extern _Bool is_matching_pattern(const wchar_t *pat)
     __attribute__((pure,nonnull));
 extern _Bool is_pathname_matching_pattern(const wchar_t *pat)
     __attribute__((pure,nonnull));
+extern wchar_t *get_pattern_literal(const wchar_t *pat)
+    __attribute__((malloc,warn_unused_result,nonnull));
 
 extern xfnmatch_T *xfnm_compile(const wchar_t *pat, xfnmflags_T flags)
     __attribute__((malloc,warn_unused_result,nonnull));